@@ -3,292 +3,293 @@
 
 #include "simgrid/s4u.hpp"
 #include "magic_constants.hpp"
+#include "sorted_ids.hpp"
+#include "random_stream.hpp"
 #include <cstdlib>
+#include <cstdint>
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+// Ids of txs and blocks. They are dense and sequential so nodes can index their structures with them
+typedef uint32_t object_id_t;
+
+// Returns an id for a new tx or block, never returned before. Id 0 is reserved for the genesis block
+object_id_t next_object_id();
 
-long lrand(long limit = 0);
-unsigned long long llrand(unsigned long long limit = 0);
-double frand(double limit = 0);
   /*
-  * Returns the next expected arrival of an activity event following a poisson distribution where:
+  * Returns the next expected arrival of an activity event following a poisson distribution, drawn from random, where:
   *   probability: chance of an event by this actor in the next second
   *   timespan: is the amount of seconds, or time frame, in which we are interested. For example a day duration for the events of transactions per day
   *   events_per_timespan: is the amount of event that we expect to occur during the considered timespan. For example 10K transactions per day
   */
-double calc_next_activity_time(double basetime, double probability, int timespan, int events_per_timespan);
+double calc_next_activity_time(RandomStream & random, double basetime, double probability, int timespan, int events_per_timespan);
 
-template<typename KeyType, typename Value, typename OtherValue>
-std::map<KeyType, Value> DiffMaps(const std::map<KeyType, Value> & left, const std::map<KeyType, OtherValue> & right)
-{
-  std::map<KeyType, Value> result;
-  typename std::map<KeyType, Value>::const_iterator il = left.begin();
-  typename std::map<KeyType, OtherValue>::const_iterator ir = right.begin();
-  while (il != left.end()) {
-    if (ir == right.end() || il->first < ir->first) {
-      result.insert(std::make_pair(il->first, il->second));
-      ++il;
-    } else if (ir != right.end()) {
-      if (il->first == ir->first) {
-        ++il;
-      }
-      ++ir;
-    }
-  }
-  return result;
-}
+/*
+* Set operations over sorted std::vector without duplicates (ie: "flat sets"). All of them run in linear time.
+* The in-place ones (MergeInto, EraseAllOf, RetainOnly) modify the target container without building a
+* temporary one, and the ones with a result parameter (IntersectInto, DiffInto) reuse its capacity.
+* The other container can be anything that can be iterated in order, like a sorted std::vector or a std::set.
+*/
 
-template<typename KeyType, typename Value>
-std::set<KeyType> DiffMaps(const std::set<KeyType> & left, const std::map<KeyType, Value> & right)
+// Adds to target the elements of source it doesn't have (union)
+template<typename KeyType, typename Container>
+void MergeInto(std::vector<KeyType> & target, const Container & source)
 {
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::map<KeyType, Value>::const_iterator ir = right.begin();
-  while (il != left.end()) {
-    if (ir == right.end() || *il < ir->first) {
-      result.insert(*il);
-      ++il;
-    } else if (ir != right.end()) {
-      if (*il == ir->first) {
-        ++il;
+  // First count how many elements we will need to add, so target grows at most once
+  size_t missing = 0;
+  typename std::vector<KeyType>::const_iterator it_target = target.begin();
+  typename Container::const_iterator it_source = source.begin();
+  while (it_source != source.end()) {
+    if (it_target == target.end() || *it_source < *it_target) {
+      ++missing;
+      ++it_source;
+    } else {
+      if (*it_source == *it_target) {
+        ++it_source;
       }
-      ++ir;
+      ++it_target;
     }
   }
-  return result;
-}
-
-template<typename KeyType, typename Value>
-std::map<KeyType, Value> DiffMaps(const std::map<KeyType, Value> & left, const std::set<KeyType> & right)
-{
-  std::map<KeyType, Value> result;
-  typename std::map<KeyType, Value>::const_iterator il = left.begin();
-  typename std::set<KeyType>::const_iterator ir = right.begin();
-  while (il != left.end()) {
-    if (ir == right.end() || il->first < *ir) {
-      result.insert(std::make_pair(il->first, il->second));
-      ++il;
-    } else if (ir != right.end()) {
-      if (il->first == *ir) {
-        ++il;
+  if (missing == 0) {
+    return;
+  }
+  size_t target_size = target.size();
+  target.resize(target_size + missing);
+  // Then merge from the back, so every element of target is moved at most once
+  typename std::vector<KeyType>::iterator write = target.end();
+  typename std::vector<KeyType>::iterator read = target.begin() + target_size;
+  typename Container::const_iterator it_back = source.end();
+  while (write != read) {
+    typename Container::const_iterator it_last = it_back;
+    --it_last;
+    if (read != target.begin() && !(*(read - 1) < *it_last)) {
+      if (*(read - 1) == *it_last) {
+        it_back = it_last;
       }
-      ++ir;
+      *(--write) = *(--read);
+    } else {
+      *(--write) = *it_last;
+      it_back = it_last;
     }
   }
-  return result;
 }
 
-template<typename KeyType, typename Value>
-std::map<KeyType, Value> JoinMaps(const std::map<KeyType, Value> & left, const std::map<KeyType, Value> & right)
+// Removes from target the elements that are also in source (difference)
+template<typename KeyType, typename Container>
+void EraseAllOf(std::vector<KeyType> & target, const Container & source)
 {
-  std::map<KeyType, Value> result;
-  typename std::map<KeyType, Value>::const_iterator il = left.begin();
-  typename std::map<KeyType, Value>::const_iterator ir = right.begin();
-  while (il != left.end() || ir != right.end()) {
-    if (il != left.end()) {
-      result.insert(std::make_pair(il->first, il->second));
-      ++il;
+  typename std::vector<KeyType>::iterator write = target.begin();
+  typename Container::const_iterator it_source = source.begin();
+  for (typename std::vector<KeyType>::iterator read = target.begin(); read != target.end(); ++read) {
+    while (it_source != source.end() && *it_source < *read) {
+      ++it_source;
     }
-    if (ir != right.end()) {
-      result.insert(std::make_pair(ir->first, ir->second));
-      ++ir;
+    if (it_source == source.end() || !(*it_source == *read)) {
+      *(write++) = *read;
     }
   }
-  return result;
+  target.erase(write, target.end());
 }
 
-template<typename KeyType, typename Value>
-std::set<KeyType> JoinMaps(const std::set<KeyType> & left, const std::map<KeyType, Value> & right)
+// Removes from target the elements that are not in source (intersection)
+template<typename KeyType, typename Container>
+void RetainOnly(std::vector<KeyType> & target, const Container & source)
 {
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::map<KeyType, Value>::const_iterator ir = right.begin();
-  while (il != left.end() || ir != right.end()) {
-    if (il != left.end()) {
-      result.insert(*il);
-      ++il;
+  typename std::vector<KeyType>::iterator write = target.begin();
+  typename Container::const_iterator it_source = source.begin();
+  for (typename std::vector<KeyType>::iterator read = target.begin(); read != target.end(); ++read) {
+    while (it_source != source.end() && *it_source < *read) {
+      ++it_source;
     }
-    if (ir != right.end()) {
-      result.insert(ir->first);
-      ++ir;
+    if (it_source != source.end() && *it_source == *read) {
+      *(write++) = *read;
     }
   }
-  return result;
+  target.erase(write, target.end());
 }
 
-template<typename KeyType, typename Value, typename OtherValue>
-std::map<KeyType, Value> IntersectMaps(const std::map<KeyType, Value> & left, const std::map<KeyType, OtherValue> & right)
+// Sets result with the elements of left that are also in right
+template<typename KeyType, typename Container>
+void IntersectInto(std::vector<KeyType> & result, const std::vector<KeyType> & left, const Container & right)
 {
-  std::map<KeyType, Value> result;
-  typename std::map<KeyType, Value>::const_iterator il = left.begin();
-  typename std::map<KeyType, OtherValue>::const_iterator ir = right.begin();
-  while (il != left.end() && ir != right.end()) {
-    if (il->first == ir->first) {
-      result.insert(*il);
-      ++il;
-      ++ir;
-    } else if (il->first < ir->first) {
-      ++il;
-    } else {
-      ++ir;
-    }
-  }
-  return result;
+  result.clear();
+  std::set_intersection(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(result));
 }
 
-template<typename KeyType, typename Value>
-std::map<KeyType, Value> IntersectMaps(const std::map<KeyType, Value> & left, const std::set<KeyType> & right)
+// Sets result with the elements of left that are not in right
+template<typename KeyType, typename Container>
+void DiffInto(std::vector<KeyType> & result, const std::vector<KeyType> & left, const Container & right)
 {
-  std::map<KeyType, Value> result;
-  typename std::map<KeyType, Value>::const_iterator il = left.begin();
-  typename std::set<KeyType>::const_iterator ir = right.begin();
-  while (il != left.end() && ir != right.end()) {
-    if (il->first == *ir) {
-      result.insert(*il);
-      ++il;
-      ++ir;
-    } else if (il->first < *ir) {
-      ++il;
-    } else {
-      ++ir;
-    }
-  }
-  return result;
+  result.clear();
+  std::set_difference(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(result));
 }
 
-template<typename KeyType, typename Value, typename... Args>
-std::map<KeyType, Value> IntersectMaps(const std::map<KeyType, Value> & left, const std::set<KeyType> & right, const std::set<Args> &... args)
+// Same as above for vectors of ids, which are the common case, using the vectorized kernels from sorted_ids.hpp
+inline void IntersectInto(std::vector<object_id_t> & result, const std::vector<object_id_t> & left, const std::vector<object_id_t> & right)
 {
-  const int n = sizeof...(args);
-  return (n > 0)
-    ? IntersectMaps(IntersectMaps(left, right), args...)
-    : IntersectMaps(left, right);
+  result.resize(std::min(left.size(), right.size()));
+  result.resize(intersect_sorted_ids(left.data(), left.size(), right.data(), right.size(), result.data()));
 }
 
-template<typename KeyType>
-std::set<KeyType> JoinSets(const std::set<KeyType> & left, const std::set<KeyType> & right)
+inline void DiffInto(std::vector<object_id_t> & result, const std::vector<object_id_t> & left, const std::vector<object_id_t> & right)
 {
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::set<KeyType>::const_iterator ir = right.begin();
-  while (il != left.end() || ir != right.end())
-  {
-    if (il != left.end()) {
-      result.insert(*il);
-      ++il;
-    }
-    if (ir != right.end()) {
-      result.insert(*ir);
-      ++ir;
-    }
-  }
-  return result;
+  result.resize(left.size());
+  result.resize(diff_sorted_ids(left.data(), left.size(), right.data(), right.size(), result.data()));
 }
 
-template<typename KeyType, typename Value>
-std::set<KeyType> JoinSets(const std::set<KeyType> & left, const std::map<KeyType, Value> & right)
+// Adds a single element keeping the vector sorted. Cheap when the new element is the greatest one,
+// which is the usual case given that ids are assigned sequentially
+template<typename KeyType>
+void InsertSorted(std::vector<KeyType> & target, KeyType key)
 {
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::map<KeyType, Value>::const_iterator ir = right.begin();
-  while (il != left.end() || ir != right.end()) {
-    if (il != left.end()) {
-      result.insert(*il);
-      ++il;
-    }
-    if (ir != right.end()) {
-      result.insert(ir->first);
-      ++ir;
-    }
+  if (target.empty() || target.back() < key) {
+    target.push_back(key);
+    return;
+  }
+  typename std::vector<KeyType>::iterator it = std::lower_bound(target.begin(), target.end(), key);
+  if (*it != key) {
+    target.insert(it, key);
   }
-  return result;
 }
 
 template<typename KeyType>
-std::set<KeyType> DiffSets(const std::set<KeyType> & left, const std::set<KeyType> & right)
+void EraseSorted(std::vector<KeyType> & target, KeyType key)
 {
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::set<KeyType>::const_iterator ir = right.begin();
-  while (il != left.end()) {
-    if (ir == right.end() || *il < *ir) {
-      result.insert(*il);
-      ++il;
-    } else if (ir != right.end()) {
-      if (*il == *ir) {
-        ++il;
-      }
-      ++ir;
-    }
+  typename std::vector<KeyType>::iterator it = std::lower_bound(target.begin(), target.end(), key);
+  if (it != target.end() && *it == key) {
+    target.erase(it);
   }
-  return result;
 }
 
-template<typename KeyType, typename... Args>
-std::set<KeyType> DiffSets(const std::set<KeyType> & left, const std::set<KeyType> & right, const std::set<Args> &... args)
+template<typename KeyType>
+bool ContainsSorted(const std::vector<KeyType> & target, KeyType key)
 {
-  const int n = sizeof...(args);
-  return (n > 0)
-    ? DiffSets(DiffSets(left, right), args...)
-    : DiffSets(left, right);
+  return std::binary_search(target.begin(), target.end(), key);
 }
 
-template<typename KeyType, typename Value>
-std::set<KeyType> DiffSets(const std::set<KeyType> & left, const std::map<KeyType, Value> & right)
+// Set of ids backed by a bitset, so checking, adding and removing an id is O(1). It's meant to be used with
+// the dense ids returned by next_object_id(): its memory is proportional to the highest id it contains
+class IdSet
 {
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::map<KeyType, Value>::const_iterator ir = right.begin();
-  while (il != left.end()) {
-    if (ir == right.end() || *il < ir->first) {
-      result.insert(*il);
-      ++il;
-    } else if (ir != right.end()) {
-      if (*il == ir->first) {
-        ++il;
-      }
-      ++ir;
+public:
+  bool contains(object_id_t id) const
+  {
+    return (id < bits.size()) && bits[id];
+  }
+
+  void insert(object_id_t id)
+  {
+    if (id >= bits.size()) {
+      bits.resize(id + 1);
+    }
+    if (!bits[id]) {
+      bits[id] = true;
+      count++;
     }
   }
-  return result;
-}
 
-template<typename KeyType>
-std::set<KeyType> IntersectSets(const std::set<KeyType> & left, const std::set<KeyType> & right)
-{
-  std::set<KeyType> result;
-  typename std::set<KeyType>::const_iterator il = left.begin();
-  typename std::set<KeyType>::const_iterator ir = right.begin();
-  while (il != left.end() && ir != right.end()) {
-    if (*il == *ir) {
-      result.insert(*il);
-      ++il;
-      ++ir;
-    } else if (*il < *ir) {
-      ++il;
-    } else {
-      ++ir;
+  void erase(object_id_t id)
+  {
+    if (contains(id)) {
+      bits[id] = false;
+      count--;
     }
   }
-  return result;
-}
 
-template<typename KeyType, typename Value>
-void Erase(std::map<KeyType, Value> & map_to_modify, KeyType key_to_remove)
-{
-  typename std::map<KeyType, Value>::const_iterator it = map_to_modify.find(key_to_remove);
-  if (it != map_to_modify.end()) {
-    map_to_modify.erase(it);
+  size_t size() const
+  {
+    return count;
   }
-}
+private:
+  std::vector<bool> bits;
+  size_t count = 0;
+};
 
-template<typename KeyType>
-void Erase(std::set<KeyType> & set_to_modify, KeyType key_to_remove)
+// Set of peer slots (the position of each peer among the peers of a node), one bit per slot. Nodes with up to 64
+// peers only use the first word, so it doesn't allocate memory. Nodes with more peers get more words as needed
+class PeerMask
 {
-  typename std::set<KeyType>::const_iterator it = set_to_modify.find(key_to_remove);
-  if (it != set_to_modify.end()) {
-    set_to_modify.erase(it);
+public:
+  bool test(int slot) const
+  {
+    if (slot < 64) {
+      return (first_word >> slot) & 1;
+    }
+    size_t i = slot / 64 - 1;
+    return (i < more_words.size()) && ((more_words[i] >> (slot % 64)) & 1);
   }
-}
+
+  void set(int slot)
+  {
+    if (slot < 64) {
+      first_word |= (uint64_t)1 << slot;
+      return;
+    }
+    size_t i = slot / 64 - 1;
+    if (i >= more_words.size()) {
+      more_words.resize(i + 1);
+    }
+    more_words[i] |= (uint64_t)1 << (slot % 64);
+  }
+
+  void reset(int slot)
+  {
+    if (slot < 64) {
+      first_word &= ~((uint64_t)1 << slot);
+      return;
+    }
+    size_t i = slot / 64 - 1;
+    if (i < more_words.size()) {
+      more_words[i] &= ~((uint64_t)1 << (slot % 64));
+    }
+  }
+
+  // Sets the slots from 0 to count - 1, and only them
+  void set_first(int count)
+  {
+    first_word = get_low_bits(count);
+    size_t words_needed = count > 64 ? (count - 1) / 64 : 0;
+    if (more_words.size() < words_needed) {
+      more_words.resize(words_needed);
+    }
+    for (size_t i = 0; i < more_words.size(); i++) {
+      more_words[i] = get_low_bits(count - 64 * (i + 1));
+    }
+  }
+
+  void clear()
+  {
+    first_word = 0;
+    std::fill(more_words.begin(), more_words.end(), 0);
+  }
+
+  bool none() const
+  {
+    if (first_word != 0) {
+      return false;
+    }
+    for (auto const& word : more_words) {
+      if (word != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+private:
+  uint64_t first_word = 0;
+  std::vector<uint64_t> more_words;
+
+  // Returns a word with its count lowest bits set
+  static uint64_t get_low_bits(int count)
+  {
+    if (count <= 0) {
+      return 0;
+    }
+    return count >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1);
+  }
+};
 
 #define LOG(...) \
       do {                     \
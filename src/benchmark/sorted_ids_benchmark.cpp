@@ -0,0 +1,147 @@
+/*
+* Compares the sorted ids kernels (sorted_ids.hpp) with the std::set based set operations that the nodes used
+* before, for sets from tens to hundreds of thousands of ids.
+* Usage: ./sorted-ids-benchmark [repetitions]
+*/
+#include "../sorted_ids.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <vector>
+
+// The std::set based operations that were in aux_functions.hpp, as the baseline
+template<typename KeyType>
+std::set<KeyType> JoinSets(const std::set<KeyType> & left, const std::set<KeyType> & right)
+{
+  std::set<KeyType> result;
+  typename std::set<KeyType>::const_iterator il = left.begin();
+  typename std::set<KeyType>::const_iterator ir = right.begin();
+  while (il != left.end() || ir != right.end())
+  {
+    if (il != left.end()) {
+      result.insert(*il);
+      ++il;
+    }
+    if (ir != right.end()) {
+      result.insert(*ir);
+      ++ir;
+    }
+  }
+  return result;
+}
+
+template<typename KeyType>
+std::set<KeyType> DiffSets(const std::set<KeyType> & left, const std::set<KeyType> & right)
+{
+  std::set<KeyType> result;
+  typename std::set<KeyType>::const_iterator il = left.begin();
+  typename std::set<KeyType>::const_iterator ir = right.begin();
+  while (il != left.end()) {
+    if (ir == right.end() || *il < *ir) {
+      result.insert(*il);
+      ++il;
+    } else if (ir != right.end()) {
+      if (*il == *ir) {
+        ++il;
+      }
+      ++ir;
+    }
+  }
+  return result;
+}
+
+template<typename KeyType>
+std::set<KeyType> IntersectSets(const std::set<KeyType> & left, const std::set<KeyType> & right)
+{
+  std::set<KeyType> result;
+  typename std::set<KeyType>::const_iterator il = left.begin();
+  typename std::set<KeyType>::const_iterator ir = right.begin();
+  while (il != left.end() && ir != right.end()) {
+    if (*il == *ir) {
+      result.insert(*il);
+      ++il;
+      ++ir;
+    } else if (*il < *ir) {
+      ++il;
+    } else {
+      ++ir;
+    }
+  }
+  return result;
+}
+
+// Returns size sorted ids taken from [0, range)
+std::vector<uint32_t> random_ids(std::mt19937 & generator, size_t size, uint32_t range)
+{
+  std::set<uint32_t> ids;
+  std::uniform_int_distribution<uint32_t> distribution(0, range - 1);
+  while (ids.size() < size) {
+    ids.insert(distribution(generator));
+  }
+  return std::vector<uint32_t>(ids.begin(), ids.end());
+}
+
+// Runs fn repetitions times and returns the average time per run in microseconds
+template<typename Function>
+double measure(int repetitions, Function fn)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repetitions; i++) {
+    fn();
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / repetitions;
+}
+
+// Prevents the compiler from optimizing away the results
+volatile size_t sink;
+
+int main(int argc, char* argv[])
+{
+  int repetitions = argc > 1 ? atoi(argv[1]) : 20;
+  std::mt19937 generator(42);
+  const size_t sizes[] = {10000, 50000, 100000, 500000};
+  // Ids are dense, so the sets of two peers overlap a lot: the range is only twice the size of the sets
+  printf("%-8s %-10s %12s", "size", "operation", "std::set");
+  const e_sorted_ids_impl impls[] = {SORTED_IDS_SCALAR, SORTED_IDS_SSE42, SORTED_IDS_AVX2};
+  for (e_sorted_ids_impl impl : impls) {
+    printf(" %12s", get_sorted_ids_impl_name(impl));
+  }
+  printf("   (microseconds per operation)\n");
+  for (size_t size : sizes) {
+    std::vector<uint32_t> left = random_ids(generator, size, size * 2);
+    std::vector<uint32_t> right = random_ids(generator, size, size * 2);
+    std::set<uint32_t> left_set(left.begin(), left.end());
+    std::set<uint32_t> right_set(right.begin(), right.end());
+    std::vector<uint32_t> out(left.size() + right.size());
+    const char* operations[] = {"intersect", "diff", "union"};
+    for (int operation = 0; operation < 3; operation++) {
+      double set_time = measure(repetitions, [&]() {
+        switch (operation) {
+          case 0: sink = IntersectSets(left_set, right_set).size(); break;
+          case 1: sink = DiffSets(left_set, right_set).size(); break;
+          default: sink = JoinSets(left_set, right_set).size(); break;
+        }
+      });
+      printf("%-8zu %-10s %12.1f", size, operations[operation], set_time);
+      for (e_sorted_ids_impl impl : impls) {
+        if (!use_sorted_ids_impl(impl)) {
+          printf(" %12s", "n/a");
+          continue;
+        }
+        double kernel_time = measure(repetitions, [&]() {
+          switch (operation) {
+            case 0: sink = intersect_sorted_ids(left.data(), left.size(), right.data(), right.size(), out.data()); break;
+            case 1: sink = diff_sorted_ids(left.data(), left.size(), right.data(), right.size(), out.data()); break;
+            default: sink = union_sorted_ids(left.data(), left.size(), right.data(), right.size(), out.data()); break;
+          }
+        });
+        printf(" %12.1f", kernel_time);
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include "client/node.hpp"
 #include "client/miner.hpp"
 #include "xbt/config.hpp"
+#include <limits>
 
 XBT_LOG_NEW_DEFAULT_CATEGORY(bitcoin_simgrid, "bitcoing-simgrid logs");
 
@@ -12,6 +13,9 @@ std::string deployment_directory;
 // This will be the single instance in charge of centralizing the generation of transactions
 CTG* ctg;
 
+// This will be the single instance that knows when the network is quiescent and when its next activity will happen
+Scheduler* scheduler;
+
 // Set-up signal handler to detect forced exits
 SignalHandler signalHandler;
 
@@ -31,12 +35,10 @@ unsigned int HASHRATE_SCALE = 1;
 // How long we'll sleep before checking for new messages when there's no more work to do
 double SLEEP_DURATION = .1;
 
-// Allow to set random generator seed in order to reproduce simulations in a deterministic way
+// Allow to set random generator seed in order to reproduce simulations in a deterministic way. Every node draws
+// random numbers from its own streams derived from it (see RandomStream)
 unsigned int SEED = 1;
 
-// Set default random number generator
-std::default_random_engine re;
-
 // In the main() function we'll init this value with the sum of nodes (normal and miners) that are part of the current simulation
 unsigned int NODES_COUNT;
 
@@ -44,6 +46,43 @@ unsigned int NODES_COUNT;
 // until the next global activity in the network
 bool SKIP_TIME_WHEN_POSSIBLE = false;
 
+// If true, instead of polling their mailboxes every SLEEP_DURATION, nodes will block until a message arrives
+// from any of their peers or until their next activity time comes up, whichever happens first
+bool EVENT_DRIVEN = false;
+
+// If true, every node receives the messages from all its peers in a single mailbox instead of having one
+// mailbox per peer, and messages carry the id of the node that sent them
+bool SINGLE_INBOX = false;
+
+// Maximum number of messages a node takes from each one of its peers in every iteration of its loop, before
+// sending its own messages. With --single-inbox the limit is this number times the number of peers
+unsigned int MAX_MESSAGES_PER_PEER = 1;
+
+// If true, all the messages a node sends to a peer in an iteration of its loop go together in a single comm
+bool COALESCE_MESSAGES = false;
+
+// Maximum size in bytes of the mempool of every node. When exceeded, the txs with the lowest fee per byte are evicted. 0 means no limit
+long MAX_MEMPOOL_SIZE = 0;
+
+// Txs that have been in the network for longer than this (in seconds) are evicted from the mempools. 0 means they never expire
+double MEMPOOL_EXPIRY = 0;
+
+// If greater than 0, instead of remembering every tx they have known about, nodes remember the txs in their
+// mempool plus at least these many of the last txs they learnt about, in a rolling bloom filter
+unsigned int ROLLING_BLOOM_FILTER_SIZE = 0;
+
+// Maximum number of blocks whose parent they don't know yet that every node keeps. When exceeded, the one that has
+// been waiting the longest is evicted
+unsigned int MAX_ORPHAN_BLOCKS = 750;
+
+// If true, when a node receives a block whose parent it doesn't know, it requests all the blocks it's missing from
+// that chain in a single GetBlocks message, instead of requesting the parent and then its parent and so on
+bool GET_BLOCKS = false;
+
+// If greater than 0, blocks these many blocks below the highest one lose their txs, and nodes refuse reorganizations
+// that would need to go through them. 0 means blocks keep their txs for the whole simulation
+unsigned int PRUNE_DEPTH = 0;
+
 // If true, more information about transactions and blocks will be included in the produced log
 bool ENABLE_DEBUG = false;
 
@@ -56,6 +95,18 @@ std::string get_usage() {
     "\t[--custom-log]\n"
     "\t[--hashrate-scale <number>]\n"
     "\t[--skip-time-when-possible]\n"
+    "\t[--event-driven]\n"
+    "\t[--single-inbox]\n"
+    "\t[--max-messages-per-peer <number>]\n"
+    "\t[--coalesce-messages]\n"
+    "\t[--max-mempool <megabytes>]\n"
+    "\t[--mempool-expiry <seconds>]\n"
+    "\t[--rolling-bloom-filter <number of txs>]\n"
+    "\t\tEach node's filter takes about 11 bytes per tx it holds, while the exact set of known txs takes 1 bit per\n"
+    "\t\tid (tx or block) created, so it only saves memory if the simulation creates over 86 ids per tx it holds\n"
+    "\t[--max-orphan-blocks <number>]\n"
+    "\t[--get-blocks]\n"
+    "\t[--prune-depth <blocks>]\n"
     "\t[--debug]";
 }
 
@@ -65,11 +116,25 @@ void print_usage()
   exit(0);
 }
 
+// Parses the value of an option that must be a number greater than 0. It's parsed as a signed number first, so a
+// negative value is rejected instead of wrapping around to a huge unsigned one
+unsigned int parse_positive_option(const char* option, const char* value)
+{
+  long parsed = std::stol(value);
+  xbt_assert(
+    parsed > 0 && parsed <= std::numeric_limits<unsigned int>::max(),
+    "%s must be greater than 0 and at most %u",
+    option,
+    std::numeric_limits<unsigned int>::max()
+  );
+  return parsed;
+}
+
 bool usingCustomLog = false;
 void parse_and_validate_args(int argc, char *argv[])
 {
   xbt_assert(
-    argc <= 13 && argc >= 3,
+    argc >= 3,
     get_usage().c_str(),
     argv[0]
   );
@@ -99,6 +164,40 @@ void parse_and_validate_args(int argc, char *argv[])
         usingCustomLog = true;
       } else if (std::string(argv[i]) == "--skip-time-when-possible") {
         SKIP_TIME_WHEN_POSSIBLE = true;
+      } else if (std::string(argv[i]) == "--event-driven") {
+        EVENT_DRIVEN = true;
+      } else if (std::string(argv[i]) == "--single-inbox") {
+        SINGLE_INBOX = true;
+      } else if (std::string(argv[i]) == "--max-messages-per-peer") {
+        xbt_assert(argc > (i + 1), "Missing argument for --max-messages-per-peer");
+        ++i;
+        MAX_MESSAGES_PER_PEER = parse_positive_option("--max-messages-per-peer", argv[i]);
+      } else if (std::string(argv[i]) == "--coalesce-messages") {
+        COALESCE_MESSAGES = true;
+      } else if (std::string(argv[i]) == "--max-mempool") {
+        xbt_assert(argc > (i + 1), "Missing argument for --max-mempool");
+        ++i;
+        MAX_MEMPOOL_SIZE = std::stol(argv[i]) * 1000000;
+        xbt_assert(MAX_MEMPOOL_SIZE > 0, "--max-mempool must be greater than 0");
+      } else if (std::string(argv[i]) == "--mempool-expiry") {
+        xbt_assert(argc > (i + 1), "Missing argument for --mempool-expiry");
+        ++i;
+        MEMPOOL_EXPIRY = std::stod(argv[i]);
+        xbt_assert(MEMPOOL_EXPIRY > 0, "--mempool-expiry must be greater than 0");
+      } else if (std::string(argv[i]) == "--rolling-bloom-filter") {
+        xbt_assert(argc > (i + 1), "Missing argument for --rolling-bloom-filter");
+        ++i;
+        ROLLING_BLOOM_FILTER_SIZE = parse_positive_option("--rolling-bloom-filter", argv[i]);
+      } else if (std::string(argv[i]) == "--max-orphan-blocks") {
+        xbt_assert(argc > (i + 1), "Missing argument for --max-orphan-blocks");
+        ++i;
+        MAX_ORPHAN_BLOCKS = parse_positive_option("--max-orphan-blocks", argv[i]);
+      } else if (std::string(argv[i]) == "--get-blocks") {
+        GET_BLOCKS = true;
+      } else if (std::string(argv[i]) == "--prune-depth") {
+        xbt_assert(argc > (i + 1), "Missing argument for --prune-depth");
+        ++i;
+        PRUNE_DEPTH = parse_positive_option("--prune-depth", argv[i]);
       } else if (std::string(argv[i]) == "--debug") {
         ENABLE_DEBUG = true;
       } else if (std::string(argv[i]) == "--help") {
@@ -110,6 +209,21 @@ void parse_and_validate_args(int argc, char *argv[])
   }
 }
 
+// Called once the simulation is over. By then nodes have released the messages that reached them (see Node::~Node()),
+// so the only messages still allocated should be those in comms that never completed, on their own or inside an
+// envelope. SimGrid destroys those comms, releasing their messages through the clean function of the send. It may
+// have done so already for some of them, so there can be less messages outstanding than in those comms, but not more
+void check_for_leaked_messages()
+{
+  unsigned long outstanding = MessagePool::get_total_outstanding();
+  unsigned long in_comms = scheduler->get_messages_in_flight() + Envelope::get_enclosed_outstanding();
+  LOG("messages outstanding at shutdown: %lu, in comms that never completed: %lu", outstanding, in_comms);
+  if (outstanding > in_comms) {
+    LOG("messages leaked: %lu", outstanding - in_comms);
+    MessagePool::report();
+  }
+}
+
 int main(int argc, char *argv[])
 {
   parse_and_validate_args(argc, argv);
@@ -120,8 +234,6 @@ int main(int argc, char *argv[])
   }
   // Specify a network model without latency assumptions that are an order of magnitude higher than need to be. See https://lists.gforge.inria.fr/pipermail/simgrid-user/2017-July/004322.html
   simgrid::config::set_parse("network/model:SMPI");
-  srand(SEED);
-  re.seed(SEED);
   e.register_actor<Node>("node");
   e.register_actor<Miner>("miner");
   e.load_platform(argv[1]);
@@ -131,8 +243,53 @@ int main(int argc, char *argv[])
   std::string deployment_file = deployment_directory + std::string("/deployment.xml");
   e.load_deployment(deployment_file.c_str());
   NODES_COUNT = e.get_actor_count();
+  scheduler = new Scheduler(NODES_COUNT);
   // Register signal handler to handle kill signal
   signalHandler.setupSignalHandlers();
   e.run();
+  LOG("mailbox lookups by name: %lu", mailbox_lookups);
+  // These are the figures to compare between runs with different --max-messages-per-peer
+  LOG(
+    "node loop iterations: %lu, messages handled: %lu (%.2f per iteration), real time: %ld ms",
+    loop_iterations,
+    messages_handled,
+    loop_iterations > 0 ? (double) messages_handled / loop_iterations : 0.0,
+    (long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - START_TIME).count()
+  );
+  // Every height has a block in the best chain, the rest of blocks ended up in stale branches
+  int highest_forks = 0;
+  for (int height = 0; height < known_blocks.get_heights_count(); height++) {
+    highest_forks = std::max(highest_forks, (int)known_blocks.get_blocks_count_at_height(height));
+  }
+  LOG(
+    "blocks: %zu, stale: %zu, max blocks at the same height: %d, pruned: %zu, reorganizations refused: %lu, pruned blocks requested: %lu, "
+    "nodes stuck below the pruned blocks: %lu",
+    known_blocks.size() - 1,
+    known_blocks.size() - known_blocks.get_heights_count(),
+    highest_forks,
+    known_blocks.get_pruned_count(),
+    refused_reorgs,
+    pruned_blocks_requested,
+    stuck_nodes
+  );
+  if (ROLLING_BLOOM_FILTER_SIZE > 0) {
+    // Without the filters, every node could end up with a bit for every id, up to the last tx
+    LOG(
+      "known txs filters: %zu KiB, exact sets would take up to %zu KiB",
+      known_txs_filters_memory / 1024,
+      NODES_COUNT * txs_table.size() / 8 / 1024
+    );
+    if (ENABLE_DEBUG) {
+      LOG(
+        "known txs lookups: %lu, false positives: %lu (%f), false negatives: %lu (%f)",
+        known_txs_lookups,
+        known_txs_false_positives,
+        known_txs_lookups > 0 ? (double)known_txs_false_positives / known_txs_lookups : 0,
+        known_txs_false_negatives,
+        known_txs_lookups > 0 ? (double)known_txs_false_negatives / known_txs_lookups : 0
+      );
+    }
+  }
+  check_for_leaked_messages();
   return 0;
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <chrono>
 #include "ctg/ctg.hpp"
+#include "client/scheduler.hpp"
 #include "signal_handler.hpp"
 
 // This is the directory where the nodes should go to look for their bootstrapping data
@@ -11,6 +12,9 @@ extern std::string deployment_directory;
 // This will be the single instance in charge of centralizing the generation of transactions
 extern CTG* ctg;
 
+// This will be the single instance that knows when the network is quiescent and when its next activity will happen
+extern Scheduler* scheduler;
+
 // Set-up signal handler to detect forced exits
 extern SignalHandler signalHandler;
 
@@ -22,7 +22,8 @@ using json = nlohmann::json;
 * run the loop where we:
 * - generate activity (if needed)
 * - handle message (receive and send message from/to the peers of this node)
-* - sleep for SLEEP_DURATION or until the next activity, whichever comes first
+* - sleep for SLEEP_DURATION or until the next activity, whichever comes first. When running with --event-driven
+*   we'll instead wait until a message arrives or until the next activity, whichever comes first
 */
 class BaseNode
 {
@@ -39,8 +40,8 @@ protected:
   virtual std::string get_node_data_filename(int id) = 0;
   virtual void generate_activity() = 0;
   virtual bool handle_messages() = 0;
-private:
-  double get_nex_sleep_time_with_perf_improvements(double next_activity_time, double sleep_duration);
+  // Blocks until a message from any peer is ready to be handled or until timeout seconds have passed
+  virtual void wait_for_messages(double timeout) = 0;
 };
 
 #endif /* BASE_NODE_HPP */
@@ -0,0 +1,121 @@
+#include "block_store.hpp"
+
+BlockStore::BlockStore()
+{
+  records.push_back(Record{std::make_shared<Block>(), 0, -1, -1});
+  positions_by_id.push_back(0);
+  positions_by_height.push_back({0});
+}
+
+void BlockStore::insert(const BlockPtr & block)
+{
+  if (contains(block->get_id())) {
+    return;
+  }
+  int parent = get_position(block->get_parent_id());
+  int height = block->get_height();
+  xbt_assert(
+    height == records[parent].height + 1,
+    "Block %u at height %d has a parent at height %d",
+    block->get_id(),
+    height,
+    records[parent].height
+  );
+  int position = records.size();
+  records.push_back(Record{block, height, parent, get_ancestor_position(parent, get_skip_height(height))});
+  if (height <= pruned_height) {
+    // A late block on a fork far below the best chain
+    records[position].block = block->get_pruned_copy();
+    pruned_count++;
+  }
+  if (block->get_id() >= positions_by_id.size()) {
+    positions_by_id.resize(block->get_id() + 1, -1);
+  }
+  positions_by_id[block->get_id()] = position;
+  if (height >= (int)positions_by_height.size()) {
+    positions_by_height.resize(height + 1);
+  }
+  positions_by_height[height].push_back(position);
+  if (PRUNE_DEPTH > 0) {
+    prune_up_to((int)positions_by_height.size() - 1 - (int)PRUNE_DEPTH);
+  }
+}
+
+void BlockStore::prune_up_to(int height)
+{
+  while (pruned_height < height) {
+    pruned_height++;
+    for (auto const& position : positions_by_height[pruned_height]) {
+      // Anyone else holding the block (eg: a message in flight) keeps the txs alive until they're done with it
+      records[position].block = records[position].block->get_pruned_copy();
+      pruned_count++;
+    }
+  }
+}
+
+object_id_t BlockStore::get_ancestor(object_id_t block_id, int height) const
+{
+  int ancestor = get_ancestor_position(get_position(block_id), height);
+  xbt_assert(ancestor >= 0, "Block %u has no ancestor at height %d", block_id, height);
+  return records[ancestor].block->get_id();
+}
+
+object_id_t BlockStore::get_last_common_ancestor(object_id_t block_id_a, object_id_t block_id_b) const
+{
+  int a = get_position(block_id_a);
+  int b = get_position(block_id_b);
+  if (records[a].height > records[b].height) {
+    a = get_ancestor_position(a, records[b].height);
+  } else if (records[b].height > records[a].height) {
+    b = get_ancestor_position(b, records[a].height);
+  }
+  // Both are at the same height now, so their skip pointers are too. If they point to different blocks, the
+  // common ancestor is below them and we can jump there. Otherwise we can only go down one block
+  while (a != b) {
+    if (records[a].skip != records[b].skip) {
+      a = records[a].skip;
+      b = records[b].skip;
+    } else {
+      a = records[a].parent;
+      b = records[b].parent;
+    }
+  }
+  return records[a].block->get_id();
+}
+
+int BlockStore::get_ancestor_position(int position, int height) const
+{
+  if (height > records[position].height || height < 0) {
+    return -1;
+  }
+  int height_walk = records[position].height;
+  while (height_walk > height) {
+    int height_skip = get_skip_height(height_walk);
+    int height_skip_prev = get_skip_height(height_walk - 1);
+    // Take the skip pointer unless it goes below the target height, or the one of the parent is a better choice
+    if (records[position].skip >= 0 && (height_skip == height || (height_skip > height && !(height_skip_prev < height_skip - 2 && height_skip_prev >= height)))) {
+      position = records[position].skip;
+      height_walk = height_skip;
+    } else {
+      position = records[position].parent;
+      height_walk--;
+    }
+  }
+  return position;
+}
+
+// Turns off the lowest bit set
+static inline int invert_lowest_one(int n)
+{
+  return n & (n - 1);
+}
+
+int BlockStore::get_skip_height(int height)
+{
+  if (height < 2) {
+    return 0;
+  }
+  // Any number strictly lower than height is acceptable, but the following expression seems to perform well
+  // in simulations (max 110 steps to go back up to 2**18 blocks), according to the reference client
+  return (height & 1) ? invert_lowest_one(invert_lowest_one(height - 1)) + 1 : invert_lowest_one(height);
+}
@@ -0,0 +1,109 @@
+#ifndef BLOCK_STORE_HPP
+#define BLOCK_STORE_HPP
+
+#include "../message.hpp"
+#include <vector>
+
+/*
+* The single store of every block broadcasted during the simulation, shared among all nodes and miners.
+* Blocks are kept in a contiguous array in the order they're added, so each one gets a dense position that never
+* changes. Positions are looked up by block id in O(1) through a vector indexed by id, and blocks are also bucketed
+* by height, so they can be visited in height order.
+* With --prune-depth, the blocks PRUNE_DEPTH blocks below the highest one are replaced by copies without their txs.
+* It's also the tree of blocks, modeled after the reference client's CBlockIndex. Besides its parent, each block
+* keeps a skip pointer to an ancestor further down its chain, chosen so that finding the ancestor of a block at any
+* height takes O(log n) steps instead of walking the chain block by block. Finding the last common ancestor of two
+* blocks uses them to get both to the same height and to jump down both branches at once, but it still
+* takes up to O(fork length) steps, as it does in the reference client.
+*/
+class BlockStore
+{
+public:
+  // Creates the store with just the genesis block
+  BlockStore();
+  // Adds a block whose parent is already in the store. Does nothing if the block is already there
+  void insert(const BlockPtr & block);
+
+  bool contains(object_id_t block_id) const
+  {
+    return (block_id < positions_by_id.size()) && (positions_by_id[block_id] >= 0);
+  }
+
+  // Returns the block with the given id, which must be in the store
+  const BlockPtr & get(object_id_t block_id) const
+  {
+    return records[get_position(block_id)].block;
+  }
+
+  // Number of blocks in the store, including the genesis one
+  size_t size() const
+  {
+    return records.size();
+  }
+
+  // Number of heights with at least one block, ie: the height of the highest block plus one
+  int get_heights_count() const
+  {
+    return positions_by_height.size();
+  }
+
+  // Number of blocks at the given height. More than one means there were forks at that height
+  size_t get_blocks_count_at_height(int height) const
+  {
+    return positions_by_height[height].size();
+  }
+
+  // Returns the i-th block added at the given height
+  const BlockPtr & get_block_at_height(int height, size_t i) const
+  {
+    return records[positions_by_height[height][i]].block;
+  }
+
+  // Blocks at this height or below have no txs (0 unless using --prune-depth, as the genesis block has none)
+  int get_pruned_height() const
+  {
+    return pruned_height;
+  }
+
+  // Number of blocks whose txs were pruned
+  size_t get_pruned_count() const
+  {
+    return pruned_count;
+  }
+
+  // Returns the id of the ancestor of the given block at the given height, which can't be higher than the block's
+  object_id_t get_ancestor(object_id_t block_id, int height) const;
+  // Returns the id of the most recent block that is an ancestor of (or the same as) both given blocks. It takes
+  // O(log n) steps to reach the height of the lowest block, plus up to one step per block of the shortest branch
+  object_id_t get_last_common_ancestor(object_id_t block_id_a, object_id_t block_id_b) const;
+private:
+  struct Record
+  {
+    BlockPtr block;
+    int height;
+    // Positions of the parent and of the block the skip pointer points to. -1 for the genesis block
+    int parent;
+    int skip;
+  };
+  std::vector<Record> records;
+  // Position of each block in records, by block id. Txs share the ids space with blocks, so there are gaps with -1
+  std::vector<int> positions_by_id;
+  // Positions of the blocks at each height, in the order they were added
+  std::vector<std::vector<int>> positions_by_height;
+  int pruned_height = 0;
+  size_t pruned_count = 0;
+
+  int get_position(object_id_t block_id) const
+  {
+    xbt_assert(contains(block_id), "Block %u is not in the block store", block_id);
+    return positions_by_id[block_id];
+  }
+
+  int get_ancestor_position(int position, int height) const;
+  // Prunes the blocks up to the given height
+  void prune_up_to(int height);
+  // Returns the height of the block the skip pointer of a block at the given height points to
+  static int get_skip_height(int height);
+};
+
+#endif /* BLOCK_STORE_HPP */
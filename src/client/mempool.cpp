@@ -0,0 +1,98 @@
+#include "mempool.hpp"
+#include <algorithm>
+
+void Mempool::add(const std::vector<object_id_t> & txs)
+{
+  DiffInto(changed_ids, txs, ids);
+  if (changed_ids.empty()) {
+    return;
+  }
+  MergeInto(ids, changed_ids);
+  for (auto const& tx_id : changed_ids) {
+    ids_by_fee_per_byte.insert(std::make_pair(txs_table.get_fee_per_byte(tx_id), tx_id));
+    ids_by_confirmed_time.insert(std::make_pair(txs_table.get_confirmed(tx_id), tx_id));
+    ids_by_created_time.insert(std::make_pair(txs_table.get_created(tx_id), tx_id));
+    size_in_bytes += txs_table.get_size(tx_id);
+  }
+}
+
+void Mempool::remove(const std::vector<object_id_t> & txs)
+{
+  IntersectInto(changed_ids, txs, ids);
+  remove_changed_ids();
+}
+
+void Mempool::expire(double created_before, std::vector<object_id_t> & removed)
+{
+  changed_ids.clear();
+  for (auto it = ids_by_created_time.begin(); it != ids_by_created_time.end() && it->first < created_before; ++it) {
+    changed_ids.push_back(it->second);
+  }
+  std::sort(changed_ids.begin(), changed_ids.end());
+  removed.insert(removed.end(), changed_ids.begin(), changed_ids.end());
+  remove_changed_ids();
+}
+
+void Mempool::trim_to_size(long max_size, std::vector<object_id_t> & removed)
+{
+  changed_ids.clear();
+  long remaining_size = size_in_bytes;
+  for (auto it = ids_by_fee_per_byte.begin(); it != ids_by_fee_per_byte.end() && remaining_size > max_size; ++it) {
+    changed_ids.push_back(it->second);
+    remaining_size -= txs_table.get_size(it->second);
+  }
+  std::sort(changed_ids.begin(), changed_ids.end());
+  removed.insert(removed.end(), changed_ids.begin(), changed_ids.end());
+  remove_changed_ids();
+}
+
+void Mempool::remove_changed_ids()
+{
+  if (changed_ids.empty()) {
+    return;
+  }
+  EraseAllOf(ids, changed_ids);
+  for (auto const& tx_id : changed_ids) {
+    ids_by_fee_per_byte.erase(std::make_pair(txs_table.get_fee_per_byte(tx_id), tx_id));
+    ids_by_confirmed_time.erase(std::make_pair(txs_table.get_confirmed(tx_id), tx_id));
+    ids_by_created_time.erase(std::make_pair(txs_table.get_created(tx_id), tx_id));
+    size_in_bytes -= txs_table.get_size(tx_id);
+  }
+}
+
+void Mempool::select_by_fee(std::vector<object_id_t> & txs, double confirmation_time, long available_size) const
+{
+  long selected_size = 0;
+  // When every tx is eligible (always the case when not reproducing a trace) we can go straight through the fee index
+  if (ids_by_confirmed_time.empty() || ids_by_confirmed_time.rbegin()->first <= confirmation_time) {
+    for (auto it = ids_by_fee_per_byte.rbegin(); it != ids_by_fee_per_byte.rend(); ++it) {
+      if (!select(txs, it->second, selected_size, available_size)) {
+        return;
+      }
+    }
+    return;
+  }
+  // Otherwise only the txs confirmed by then are sorted by fee, instead of skipping the rest all over the fee index
+  eligible_by_fee.clear();
+  auto last_eligible = ids_by_confirmed_time.upper_bound(std::make_pair(confirmation_time, UINT32_MAX));
+  for (auto it = ids_by_confirmed_time.begin(); it != last_eligible; ++it) {
+    eligible_by_fee.push_back(std::make_pair(txs_table.get_fee_per_byte(it->second), it->second));
+  }
+  std::sort(eligible_by_fee.rbegin(), eligible_by_fee.rend());
+  for (auto const& fee_and_id : eligible_by_fee) {
+    if (!select(txs, fee_and_id.second, selected_size, available_size)) {
+      return;
+    }
+  }
+}
+
+bool Mempool::select(std::vector<object_id_t> & txs, object_id_t tx_id, long & selected_size, long available_size)
+{
+  long tx_size = txs_table.get_size(tx_id);
+  if ((selected_size + tx_size) > available_size) {
+    return false;
+  }
+  selected_size += tx_size;
+  txs.push_back(tx_id);
+  return true;
+}
@@ -0,0 +1,74 @@
+#ifndef MEMPOOL_HPP
+#define MEMPOOL_HPP
+
+#include "../aux_functions.hpp"
+#include "../transactions_table.hpp"
+#include <set>
+#include <vector>
+
+/*
+* The unconfirmed txs known by a node. Besides the sorted ids, which are used in the set operations with the
+* per-peer containers, it keeps the txs ordered by fee per byte and by confirmation time, and their total size.
+* All of them are updated as txs are added and removed, so miners can pick the txs for a new block without
+* going through (and sorting) the whole mempool. It also keeps them ordered by creation time, so the mempool can be
+* kept under a maximum size (--max-mempool) and old txs expired (--mempool-expiry) without going through it.
+*/
+class Mempool
+{
+public:
+  // Adds the given txs, which must be sorted, skipping the ones already in the mempool
+  void add(const std::vector<object_id_t> & txs);
+  // Removes the given txs, which must be sorted, skipping the ones not in the mempool
+  void remove(const std::vector<object_id_t> & txs);
+  // Adds to txs the txs with the highest fee per byte that were confirmed at confirmation_time or before
+  // (in the real blockchain when reproducing a trace), until one doesn't fit in available_size bytes
+  void select_by_fee(std::vector<object_id_t> & txs, double confirmation_time, long available_size) const;
+  // Removes the txs created before created_before, adding their ids to removed
+  void expire(double created_before, std::vector<object_id_t> & removed);
+  // Removes the txs with the lowest fee per byte until the mempool takes at most max_size bytes, adding their ids to removed
+  void trim_to_size(long max_size, std::vector<object_id_t> & removed);
+
+  // Returns the sorted ids of the txs in the mempool
+  const std::vector<object_id_t> & get_ids() const
+  {
+    return ids;
+  }
+
+  bool contains(object_id_t id) const
+  {
+    return ContainsSorted(ids, id);
+  }
+
+  size_t size() const
+  {
+    return ids.size();
+  }
+
+  // Returns the sum of the sizes of the txs in the mempool
+  long get_size_in_bytes() const
+  {
+    return size_in_bytes;
+  }
+private:
+  std::vector<object_id_t> ids;
+  // (fee per byte, id) of every tx, ordered by fee per byte
+  std::set<std::pair<long, object_id_t>> ids_by_fee_per_byte;
+  // (confirmation time, id) of every tx, ordered by confirmation time
+  std::set<std::pair<double, object_id_t>> ids_by_confirmed_time;
+  // (creation time, id) of every tx, ordered by creation time
+  std::set<std::pair<double, object_id_t>> ids_by_created_time;
+  long size_in_bytes = 0;
+  // Scratch space for add(), remove(), expire() and trim_to_size(), so they don't need to allocate every time
+  std::vector<object_id_t> changed_ids;
+  // Scratch space for select_by_fee(): (fee per byte, id) of the txs eligible for a block when reproducing a trace
+  mutable std::vector<std::pair<long, object_id_t>> eligible_by_fee;
+
+  // Adds tx_id to txs if it fits in available_size along with the selected_size bytes already selected. Returns
+  // false if it doesn't, which ends the selection
+  static bool select(std::vector<object_id_t> & txs, object_id_t tx_id, long & selected_size, long available_size);
+
+  // Removes changed_ids, which must be sorted and in the mempool, from the ids and every index
+  void remove_changed_ids();
+};
+
+#endif /* MEMPOOL_HPP */
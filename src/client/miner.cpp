@@ -16,6 +16,7 @@ Miner::Miner(std::vector<std::string> args): Node::Node()
 void Miner::init_from_args(std::vector<std::string> args)
 {
   Node::init_from_args(args);
+  random = RandomStream(SEED, RANDOM_STREAM_MINER, my_id);
   std::string mode = node_data["mode"].get<std::string>();
   using_trace = mode == "trace";
   using_selfish_mining = mode == "model_using_selfish_mining";
@@ -46,7 +47,7 @@ void Miner::do_set_next_activity_time()
   } else {
     int timespan = INTERVAL_BETWEEN_BLOCKS_IN_SECONDS;// 10 minutes by default if not using the --target-time option
     double event_probability = get_event_probability();
-    next_activity_time = calc_next_activity_time(next_activity_time, event_probability, timespan, HASHRATE_SCALE);
+    next_activity_time = calc_next_activity_time(random, next_activity_time, event_probability, timespan, HASHRATE_SCALE);
     LOG("next activity will be %f", next_activity_time);
   }
 }
@@ -60,56 +61,55 @@ double Miner::get_event_probability()
   return event_probability;
 }
 
-bool Miner::handle_block(int relayed_by_peer_id, Block *message, bool force_broadcast)
+bool Miner::handle_block(int relayed_by_peer_id, const BlockPtr & block, bool /*force_broadcast*/)
 {
   if (using_selfish_mining) {
-    bool returnValue = false;
-    if (message->get_miner_id() == my_id) {
-      Node::blockchain_tip_updated(relayed_by_peer_id, Block(*message));
-      if (message->get_height() > best_competing_height) {
+    if (block->get_miner_id() == my_id) {
+      Node::blockchain_tip_updated(relayed_by_peer_id, block);
+      if (block->get_height() > best_competing_height) {
         // The block I mined is the best chain so far AND is ahead by at least 1 from others
         // I have a cushion to keep withholding this block and only reveal it when needed to
         // maintain the status quo
-        DEBUG("[selfish mining] our height %d vs %d from others", message->get_height(), best_competing_height);
-        pending_blocks.insert(std::make_pair(message->get_id(), Block(*message)));
-        Node::blockchain_tip_updated(relayed_by_peer_id, Block(*message));
+        DEBUG("[selfish mining] our height %d vs %d from others", block->get_height(), best_competing_height);
+        pending_blocks.insert(std::make_pair(block->get_id(), block));
+        Node::blockchain_tip_updated(relayed_by_peer_id, block);
         return false;
       }
     } else {
-      best_competing_height = std::max(best_competing_height, message->get_height());
-      if (Node::blockchain_tip_updated(relayed_by_peer_id, Block(*message))) {
+      best_competing_height = std::max(best_competing_height, block->get_height());
+      if (Node::blockchain_tip_updated(relayed_by_peer_id, block)) {
         // We received a block from other miner which represents a better chain than ours
         // Discard our private chain
         pending_blocks.clear();
       } else {
         // We received a messsage from others which doesn't represent a better chain than ours.
-        // From our pending blocks publish message->get_height() + 1 to keep the status quo
-        DEBUG("[selfish mining] keeping status quo at height %d", message->get_height());
-        return announce_pending_blocks(message->get_height() + 1);
+        // From our pending blocks publish block->get_height() + 1 to keep the status quo
+        DEBUG("[selfish mining] keeping status quo at height %d", block->get_height());
+        return announce_pending_blocks(block->get_height() + 1);
       }
     }
   }
   // I'm not using selfish mining or I have to accept an alternative chain better than mine
-  return Node::handle_block(relayed_by_peer_id, message, message->get_miner_id() == my_id);
+  return Node::handle_block(relayed_by_peer_id, block, block->get_miner_id() == my_id);
 }
 
 bool Miner::announce_pending_blocks(int up_to_height)
 {
-  std::map<int, Block> new_pending_blocks;
-  typename std::map<int, Block>::const_iterator it = pending_blocks.begin();
+  std::map<object_id_t, BlockPtr> new_pending_blocks;
+  typename std::map<object_id_t, BlockPtr>::const_iterator it = pending_blocks.begin();
   while (it != pending_blocks.end()) {
-    Block block = it->second;
-    if (block.get_height() <= up_to_height) {
-      DEBUG("announcing %ld of height %d <= %d", block.get_id(), block.get_height(), up_to_height);
-      Node::handle_block(my_id, new Block(block), true);
+    const BlockPtr & block = it->second;
+    if (block->get_height() <= up_to_height) {
+      DEBUG("announcing %u of height %d <= %d", block->get_id(), block->get_height(), up_to_height);
+      Node::handle_block(my_id, block, true);
     } else {
-      DEBUG("not announcing %ld of height %d > %d", block.get_id(), block.get_height(), up_to_height);
-      new_pending_blocks.insert(std::make_pair(block.get_id(), block));
+      DEBUG("not announcing %u of height %d > %d", block->get_id(), block->get_height(), up_to_height);
+      new_pending_blocks.insert(std::make_pair(block->get_id(), block));
     }
     ++it;
   }
   bool some_work_done = pending_blocks.size() != new_pending_blocks.size();
-  pending_blocks = new_pending_blocks;
+  pending_blocks.swap(new_pending_blocks);
   return some_work_done;
 }
 
@@ -119,77 +119,38 @@ void Miner::generate_activity()
   if (next_activity_time > simgrid::s4u::Engine::get_clock()) {
     return;
   }
-  Block *block;
-  std::vector<Transaction> txs_to_include;
-  unsigned long long accumulated_difficulty = known_blocks[blockchain_tip].get_accumulated_difficulty() + difficulty;
+  BlockPtr block;
+  std::vector<object_id_t> txs_to_include;
+  unsigned long long accumulated_difficulty = blockchain_tip_block->get_accumulated_difficulty() + difficulty;
   if (using_trace) {
     // I need to add to the block the coinbase tx and all the txs that only appeared
     // in the network when this block was broadcasted
     TraceItemMiner traceItem = trace[current_trace_index - 1];
     for (auto const& size_and_fee : traceItem.txs_broadcasted_in_block) {
-      Transaction tx = create_transaction(size_and_fee.first, size_and_fee.second, next_activity_time);
-      txs_to_include.push_back(tx);
+      txs_to_include.push_back(create_transaction(size_and_fee.first, size_and_fee.second, next_activity_time));
     }
     add_mempool_transactions(txs_to_include, next_activity_time);
-    block = new Block(blockchain_height + 1, simgrid::s4u::Engine::get_clock(), blockchain_tip, difficulty, accumulated_difficulty, txs_to_include, my_id);
-    LOG("creating block %ld with %ld txs and we expected %d. height: %d, parent %ld", block->get_id(), txs_to_include.size(), traceItem.n_tx, block->get_height(), block->get_parent_id());
+    block = std::make_shared<Block>(blockchain_height + 1, simgrid::s4u::Engine::get_clock(), blockchain_tip, difficulty, accumulated_difficulty, txs_to_include, my_id);
+    LOG("creating block %u with %ld txs and we expected %d. height: %d, parent %u", block->get_id(), txs_to_include.size(), traceItem.n_tx, block->get_height(), block->get_parent_id());
   } else {
     // I need to include the coinbase tx
-    long size = lrand(AVERAGE_BYTES_PER_TX * 2);// On average txs size will be AVERAGE_BYTES_PER_TX bytes
-    long fee_per_byte = lrand(AVERAGE_FEE_PER_BYTE * 2);// On average txs fee per byte will be AVERAGE_FEE_PER_BYTE bytes
-    Transaction tx = create_transaction(size, fee_per_byte, next_activity_time);
-    txs_to_include.push_back(tx);
+    long size = random.lrand(AVERAGE_BYTES_PER_TX * 2);// On average txs size will be AVERAGE_BYTES_PER_TX bytes
+    long fee_per_byte = random.lrand(AVERAGE_FEE_PER_BYTE * 2);// On average txs fee per byte will be AVERAGE_FEE_PER_BYTE bytes
+    txs_to_include.push_back(create_transaction(size, fee_per_byte, next_activity_time));
     add_mempool_transactions(txs_to_include, next_activity_time);
-    block = new Block(blockchain_height + 1, simgrid::s4u::Engine::get_clock(), blockchain_tip, difficulty, accumulated_difficulty, txs_to_include, my_id);
-    LOG("creating block %ld with %ld txs. height: %d, parent %ld", block->get_id(), txs_to_include.size(), block->get_height(), block->get_parent_id());
+    block = std::make_shared<Block>(blockchain_height + 1, simgrid::s4u::Engine::get_clock(), blockchain_tip, difficulty, accumulated_difficulty, txs_to_include, my_id);
+    LOG("creating block %u with %ld txs. height: %d, parent %u", block->get_id(), txs_to_include.size(), block->get_height(), block->get_parent_id());
   }
-  mempool = JoinMaps(mempool, block->get_transactions_map());
+  mempool.add(block->get_transactions());
   do_set_next_activity_time();
   handle_block(my_id, block);
-  delete block;
 }
 
-void Miner::add_mempool_transactions(std::vector<Transaction> &txs_to_include, double confirmation_time)
+void Miner::add_mempool_transactions(std::vector<object_id_t> &txs_to_include, double confirmation_time)
 {
-  std::vector<Transaction> mempool_txs_to_add;
-  for (auto const& idAndTransaction : mempool) {
-    // Only include txs that were confirmed since this block was created . If we're reproducing a trace we know when they were
-    // confirmed in the "real blockchain"). In that situation, this check would ideally mean including them in the very same
-    // block where they were confirmed (if the tx had time to reach the miner since it was broadcasted by the node that created it)
-    if (confirmation_time >= idAndTransaction.second.get_confirmed()) {
-      mempool_txs_to_add.push_back(idAndTransaction.second);
-    }
-  }
-  sort(mempool_txs_to_add.begin(), mempool_txs_to_add.end(), [](const Transaction & a, const Transaction & b) -> bool
-  {
-    return b.get_fee_per_byte() > a.get_fee_per_byte();
-  });
-  long available_size = MAX_BLOCK_SIZE - get_transactions_size(txs_to_include);
-  if (get_transactions_size(mempool_txs_to_add) > available_size) {
-    restrict_transactions_to_available_size(mempool_txs_to_add, available_size);
-  }
-  txs_to_include.insert(txs_to_include.end(), mempool_txs_to_add.begin(), mempool_txs_to_add.end());
-}
-
-long Miner::get_transactions_size(std::vector<Transaction> txs)
-{
-  long size = 0;
-  for (auto const& tx : txs) {
-    size += tx.get_size();
-  }
-  return size;
-}
-
-void Miner::restrict_transactions_to_available_size(std::vector<Transaction> &txs, long available_size)
-{
-  std::vector<Transaction> result;
-  long size = 0;
-  for (auto const& tx : txs) {
-    if ((size + tx.get_size()) > available_size) {
-      break;
-    }
-    size += tx.get_size();
-    result.push_back(tx);
-  }
-  txs = result;
+  // Only include txs that were confirmed since this block was created . If we're reproducing a trace we know when they were
+  // confirmed in the "real blockchain"). In that situation, this check would ideally mean including them in the very same
+  // block where they were confirmed (if the tx had time to reach the miner since it was broadcasted by the node that created it)
+  long available_size = MAX_BLOCK_SIZE - txs_table.get_size(txs_to_include);
+  mempool.select_by_fee(txs_to_include, confirmation_time, available_size);
 }
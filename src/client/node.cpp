@@ -27,15 +27,69 @@ void Node::init_from_args(std::vector<std::string> args)
   difficulty = node_data["difficulty"].get<unsigned long long>();
   creates_txs = node_data["creates_txs"].get<bool>();
   xbt_assert(difficulty > 0, "Network difficulty must be greater than 0, got %llu", difficulty);
+  known_blocks_ids.insert(0);
+  blockchain_tip_block = known_blocks.get(0);
+  if (ROLLING_BLOOM_FILTER_SIZE > 0) {
+    recent_txs_ids.reset(new RollingBloomFilter(ROLLING_BLOOM_FILTER_SIZE, ROLLING_BLOOM_FILTER_FP_RATE, my_id));
+    known_txs_filters_memory += recent_txs_ids->get_memory_size();
+  }
+  if (MAX_MEMPOOL_SIZE > 0 || MEMPOOL_EXPIRY > 0) {
+    // With a different tweak than recent_txs_ids, so they don't make the same false positives
+    recently_evicted_txs_ids.reset(new RollingBloomFilter(RECENTLY_EVICTED_TXS_FILTER_SIZE, ROLLING_BLOOM_FILTER_FP_RATE, ~(uint32_t)my_id));
+  }
   do_set_next_activity_time();
-  for (std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-    int peer_id = *it_id;
-    get_peer_incoming_mailbox(peer_id)->set_receiver(simgrid::s4u::Actor::self());
+  peers.resize(my_peers.size());
+  for (int peer_slot = 0; peer_slot < (int)my_peers.size(); peer_slot++) {
+    int peer_id = my_peers[peer_slot];
+    peers[peer_slot].id = peer_id;
+    peer_slots[peer_id] = peer_slot;
+    if (SINGLE_INBOX) {
+      peers[peer_slot].outgoing_mailbox = get_inbox(peer_id);
+    } else {
+      peers[peer_slot].incoming_mailbox = get_peer_incoming_mailbox(peer_id);
+      peers[peer_slot].outgoing_mailbox = get_peer_outgoing_mailbox(peer_id);
+      peers[peer_slot].incoming_mailbox->set_receiver(simgrid::s4u::Actor::self());
+    }
+  }
+  if (SINGLE_INBOX) {
+    inbox = get_inbox(my_id);
+    inbox->set_receiver(simgrid::s4u::Actor::self());
+  }
+}
+
+// Actors get killed when the simulation ends, which unwinds their stack. Release here the messages that reached
+// us but we never handled, and the ones we were about to send
+Node::~Node()
+{
+  for (auto & peer : peers) {
+    release_pending_message(peer.pending_payload);
+    for (auto const& message : peer.messages_to_coalesce) {
+      delete message;
+    }
+  }
+  release_pending_message(inbox_pending_payload);
+  if (PRUNE_DEPTH > 0) {
+    // A node whose chain forks from the highest one below the pruned blocks refused to switch to it, and it never
+    // will, since pruning only goes up
+    object_id_t highest_block_id = known_blocks.get_block_at_height(known_blocks.get_heights_count() - 1, 0)->get_id();
+    object_id_t common_parent_id = known_blocks.get_last_common_ancestor(blockchain_tip, highest_block_id);
+    int common_parent_height = known_blocks.get(common_parent_id)->get_height();
+    if (common_parent_height < known_blocks.get_pruned_height()) {
+      LOG(
+        "stuck at block %u at height %d, whose chain forks from the one of block %u at height %d, below the pruned height %d",
+        blockchain_tip,
+        blockchain_height,
+        highest_block_id,
+        common_parent_height,
+        known_blocks.get_pruned_height()
+      );
+      stuck_nodes++;
+    }
   }
 }
 
 std::string Node::get_node_data_filename(int id) {
-  return deployment_directory + simgrid::s4u::this_actor::get_name() + std::string("_data-") + std::to_string(my_id);
+  return deployment_directory + simgrid::s4u::this_actor::get_name() + std::string("_data-") + std::to_string(id);
 }
 
 void Node::do_set_next_activity_time()
@@ -64,56 +118,252 @@ void Node::generate_activity()
   if (next_activity_time > simgrid::s4u::Engine::get_clock()) {
     return;
   }
-  std::map<long, Transaction> txs;
-  Transaction tx = create_transaction(next_activity_item.size, next_activity_item.fee_per_byte, next_activity_item.confirmed);
-  txs.insert(std::make_pair(tx.get_id(), tx));
-  Transactions *my_unconfirmed_txs = new Transactions(txs);
+  object_id_t tx_id = create_transaction(next_activity_item.size, next_activity_item.fee_per_byte, next_activity_item.confirmed);
+  Transactions *my_unconfirmed_txs = new Transactions({tx_id});
   do_set_next_activity_time();
   handle_transactions(my_id, my_unconfirmed_txs);
   delete my_unconfirmed_txs;
 }
 
-Transaction Node::create_transaction(long size, long fee_per_byte, double confirmed)
+object_id_t Node::create_transaction(long size, long fee_per_byte, double confirmed)
 {
-  Transaction tx = Transaction(size, fee_per_byte, confirmed);
-  LOG("creating tx %ld", tx.get_id());
-  return tx;
+  object_id_t tx_id = txs_table.create(size, fee_per_byte, confirmed, simgrid::s4u::Engine::get_clock());
+  LOG("creating tx %u", tx_id);
+  return tx_id;
 }
 
 bool Node::handle_messages()
 {
   bool has_work_to_do = false;
-  for (std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-    int peer_id = *it_id;
-    has_work_to_do |= receive_messages_from_peer(peer_id);
-    send_messages_to_peer(peer_id);
-    cleanup(peer_id);
+  if (SINGLE_INBOX) {
+    has_work_to_do = receive_messages_from_inbox();
+    // Only the dirty peers may have something to send. Visit them in the same order as my_peers, as we would do
+    // if we went through all of them
+    std::sort(dirty_peers.begin(), dirty_peers.end());
+    for (int peer_slot : dirty_peers) {
+      send_messages_to_peer(peers[peer_slot]);
+      cleanup(peers[peer_slot]);
+    }
+    dirty_peers.clear();
+    return has_work_to_do;
+  }
+  // We still have to check every mailbox, but we only send to the dirty peers. A peer can get dirty after its
+  // turn, because of a message from a peer after it, so it will be handled in the next iteration
+  for (auto & peer : peers) {
+    has_work_to_do |= receive_messages_from_peer(peer);
+    if (peer.dirty) {
+      send_messages_to_peer(peer);
+      cleanup(peer);
+    }
   }
+  dirty_peers.erase(
+    std::remove_if(dirty_peers.begin(), dirty_peers.end(), [this](int peer_slot) { return !peers[peer_slot].dirty; }),
+    dirty_peers.end()
+  );
   return has_work_to_do;
 }
 
-bool Node::receive_messages_from_peer(int peer_id)
+void Node::wait_for_messages(double timeout)
 {
-  simgrid::s4u::MailboxPtr mbox = get_peer_incoming_mailbox(peer_id);
-  if (!mbox->listen()) {
-    return false;
+  if (timeout <= 0) {
+    return;
+  }
+  std::vector<simgrid::s4u::CommPtr> comms;
+  if (SINGLE_INBOX) {
+    if (!inbox_pending_receive) {
+      inbox_pending_receive = inbox->get_async(&inbox_pending_payload);
+    }
+    comms.push_back(inbox_pending_receive);
+  } else {
+    for (auto & peer : peers) {
+      if (!peer.pending_receive) {
+        peer.pending_receive = peer.incoming_mailbox->get_async(&peer.pending_payload);
+      }
+      comms.push_back(peer.pending_receive);
+    }
+  }
+  // We don't care about which comm finished (or if we timed out), handle_messages() will find out
+  simgrid::s4u::Comm::wait_any_for(&comms, timeout);
+}
+
+PeerState & Node::get_peer(int peer_id)
+{
+  std::unordered_map<int, int>::const_iterator it = peer_slots.find(peer_id);
+  xbt_assert(it != peer_slots.end(), "Node %d is not a peer of node %d", peer_id, my_id);
+  return peers[it->second];
+}
+
+void Node::mark_dirty(PeerState & peer)
+{
+  if (!peer.dirty) {
+    peer.dirty = true;
+    dirty_peers.push_back(get_slot(peer));
+  }
+}
+
+InventoryEntry & Node::get_inventory_entry(object_id_t id, bool is_block)
+{
+  std::unordered_map<object_id_t, int>::const_iterator it = inventory_slots.find(id);
+  if (it != inventory_slots.end()) {
+    return inventory[it->second];
+  }
+  // Reuse the slot of an entry that was released, if any, so the inventory doesn't need to be compacted
+  int slot = inventory.size();
+  if (free_inventory_slots.empty()) {
+    inventory.emplace_back();
+  } else {
+    slot = free_inventory_slots.back();
+    free_inventory_slots.pop_back();
+  }
+  inventory_slots[id] = slot;
+  InventoryEntry & entry = inventory[slot];
+  entry.id = id;
+  entry.is_block = is_block;
+  return entry;
+}
+
+InventoryEntry* Node::find_inventory_entry(object_id_t id)
+{
+  std::unordered_map<object_id_t, int>::const_iterator it = inventory_slots.find(id);
+  return it == inventory_slots.end() ? nullptr : &inventory[it->second];
+}
+
+void Node::track_inventory_entry(const InventoryEntry & entry, int slot)
+{
+  if (!entry.to_broadcast.test(slot) && !entry.known.test(slot)) {
+    peers[slot].inventory_ids.push_back(entry.id);
+  }
+}
+
+void Node::announce_to_peers(object_id_t id, bool is_block)
+{
+  InventoryEntry & entry = get_inventory_entry(id, is_block);
+  for (int slot = 0; slot < (int)peers.size(); slot++) {
+    track_inventory_entry(entry, slot);
+  }
+  entry.to_broadcast.set_first(peers.size());
+  for (auto & peer : peers) {
+    mark_dirty(peer);
+  }
+}
+
+void Node::announce_to_peers(const std::vector<object_id_t> & ids, bool is_block)
+{
+  if (ids.empty()) {
+    return;
+  }
+  for (auto const& id : ids) {
+    InventoryEntry & entry = get_inventory_entry(id, is_block);
+    for (int slot = 0; slot < (int)peers.size(); slot++) {
+      track_inventory_entry(entry, slot);
+    }
+    entry.to_broadcast.set_first(peers.size());
+  }
+  for (auto & peer : peers) {
+    mark_dirty(peer);
+  }
+}
+
+void Node::set_known_by_peer(PeerState & peer, object_id_t id, bool is_block)
+{
+  InventoryEntry & entry = get_inventory_entry(id, is_block);
+  track_inventory_entry(entry, get_slot(peer));
+  entry.known.set(get_slot(peer));
+}
+
+void Node::release_inventory_entry_if_unused(InventoryEntry & entry)
+{
+  if (entry.to_broadcast.none() && entry.known.none()) {
+    inventory_slots.erase(entry.id);
+    free_inventory_slots.push_back(&entry - inventory.data());
+  }
+}
+
+void* Node::get_ready_message(simgrid::s4u::MailboxPtr mbox, simgrid::s4u::CommPtr & pending_receive, void* & pending_payload)
+{
+  if (!EVENT_DRIVEN) {
+    return mbox->listen() ? mbox->get() : nullptr;
+  }
+  // While event driven we always keep a reception posted on the mailbox, so wait_for_messages() can block on it
+  if (!pending_receive) {
+    pending_receive = mbox->get_async(&pending_payload);
+  }
+  if (!pending_receive->test()) {
+    return nullptr;
   }
-  void* data = mbox->get();
-  received_messages++;
-  bool has_work_to_do = mbox->ready();
-  Message *payload = static_cast<Message*>(data);
+  pending_receive = nullptr;
+  // Nothing is pending anymore, so it's not left behind when we shut down
+  void* payload = pending_payload;
+  pending_payload = nullptr;
+  return payload;
+}
+
+void Node::release_pending_message(void* & pending_payload)
+{
+  if (pending_payload != nullptr) {
+    delete static_cast<Message*>(pending_payload);
+    scheduler->message_received();
+    pending_payload = nullptr;
+  }
+}
+
+bool Node::receive_messages_from_peer(PeerState & peer)
+{
+  bool has_work_to_do = false;
+  for (unsigned int i = 0; i < MAX_MESSAGES_PER_PEER; i++) {
+    void* data = get_ready_message(peer.incoming_mailbox, peer.pending_receive, peer.pending_payload);
+    if (data == nullptr) {
+      return has_work_to_do;
+    }
+    scheduler->message_received();
+    has_work_to_do |= handle_message(peer.id, static_cast<Message*>(data));
+  }
+  return has_work_to_do || peer.incoming_mailbox->ready();
+}
+
+bool Node::receive_messages_from_inbox()
+{
+  bool has_work_to_do = false;
+  // Take at most as many messages as we would take when having a mailbox per peer
+  for (size_t i = 0; i < MAX_MESSAGES_PER_PEER * peers.size(); i++) {
+    void* data = get_ready_message(inbox, inbox_pending_receive, inbox_pending_payload);
+    if (data == nullptr) {
+      return has_work_to_do;
+    }
+    scheduler->message_received();
+    Message *payload = static_cast<Message*>(data);
+    has_work_to_do |= handle_message(payload->get_sender_id(), payload);
+  }
+  return has_work_to_do || inbox->ready();
+}
+
+bool Node::handle_message(int peer_id, Message *payload)
+{
+  messages_handled++;
+  bool has_work_to_do = false;
   switch (payload->get_type()) {
     case MESSAGE_BLOCK:
-      has_work_to_do |= handle_block(peer_id, static_cast<Block*>(data));
+      has_work_to_do |= handle_block(peer_id, static_cast<BlockMessage*>(payload)->get_block());
       break;
     case MESSAGE_TXS:
-      has_work_to_do |= handle_transactions(peer_id, static_cast<Transactions*>(data));
+      has_work_to_do |= handle_transactions(peer_id, static_cast<Transactions*>(payload));
       break;
     case MESSAGE_INV:
-      handle_inv(peer_id, static_cast<Inv*>(data));
+      handle_inv(peer_id, static_cast<Inv*>(payload));
       break;
     case MESSAGE_GETDATA:
-      handle_getdata(peer_id, static_cast<GetData*>(data));
+      handle_getdata(peer_id, static_cast<GetData*>(payload));
+      break;
+    case MESSAGE_GETBLOCKS:
+      handle_getblocks(peer_id, static_cast<GetBlocks*>(payload));
+      break;
+    case MESSAGE_NOTFOUND:
+      handle_notfound(peer_id, static_cast<NotFound*>(payload));
+      break;
+    case MESSAGE_ENVELOPE:
+      for (auto const& message : static_cast<Envelope*>(payload)->release_messages()) {
+        has_work_to_do |= handle_message(peer_id, message);
+      }
       break;
     default:
       THROW_IMPOSSIBLE;
@@ -122,149 +372,237 @@ bool Node::receive_messages_from_peer(int peer_id)
   return has_work_to_do;
 }
 
+void Node::send_message(PeerState & peer, Message *message)
+{
+  if (COALESCE_MESSAGES) {
+    peer.messages_to_coalesce.push_back(message);
+  } else {
+    put_message(peer, message);
+  }
+}
+
+void Node::send_coalesced_messages(PeerState & peer)
+{
+  if (peer.messages_to_coalesce.size() == 1) {
+    // No need for an envelope
+    put_message(peer, peer.messages_to_coalesce.front());
+  } else if (peer.messages_to_coalesce.size() > 1) {
+    put_message(peer, new Envelope(peer.messages_to_coalesce));
+  }
+  peer.messages_to_coalesce.clear();
+}
+
+// Deletes the message of a detached comm that gets destroyed before being received (eg: at shutdown)
+static void destroy_message(void* message)
+{
+  delete static_cast<Message*>(message);
+}
+
+void Node::put_message(PeerState & peer, Message *message)
+{
+  scheduler->message_sent();
+  message->set_sender_id(my_id);
+  peer.outgoing_mailbox->put_init(message, message->get_size())->detach(destroy_message);
+}
+
 /* We won't relay any messages in the next iteration unless:
 * a) we have to notify that among our inventory we have a new block
 * b) we have to notify that among our inventory we have new unconfirmed tx
 * c) we need to inform our peer that we know of a new block or tx
 * d) we need to request to our peer for a block or tx the peer know about
 */
-void Node::send_messages_to_peer(int peer_id)
+void Node::send_messages_to_peer(PeerState & peer)
 {
-  send_blocks(peer_id);
-  send_transactions(peer_id);
-  inv(peer_id);
-  getdata(peer_id);
+  send_blocks(peer);
+  send_transactions(peer);
+  inv(peer);
+  getdata(peer);
+  getblocks(peer);
+  notfound(peer);
+  if (COALESCE_MESSAGES) {
+    send_coalesced_messages(peer);
+  }
 }
 
-void Node::send_blocks(int peer_id)
+void Node::send_blocks(PeerState & peer)
 {
   // We will let the peer know about new blocks (but we won't send the blocks that we know the peer already knows)
   // The blocks I need to send other peers are those that a peer has requested to me, that I know about and that exist in the shared blocks variable
-  std::map<long, Block> blocks_to_send = IntersectMaps(known_blocks, known_blocks_ids, objects_to_send_to_peer[peer_id]);
-  blocks_known_by_peer[peer_id] = JoinMaps(blocks_known_by_peer[peer_id], blocks_to_send);
-  typename std::map<long, Block>::const_iterator it_block = blocks_to_send.begin();
-  while (it_block != blocks_to_send.end()) {
-    sent_messages++;
-    LOG("sending block %ld to %d", it_block->first, peer_id);
-    simgrid::s4u::MailboxPtr mbox = get_peer_outgoing_mailbox(peer_id);
-    Message *message = new Block(it_block->second);
-    mbox->put_init(message, message->get_size())->detach();
-    ++it_block;
+  std::vector<object_id_t> blocks_ids_to_send;
+  for (auto const& id : peer.objects_to_send) {
+    if (known_blocks_ids.contains(id)) {
+      blocks_ids_to_send.push_back(id);
+    }
+  }
+  for (auto const& block_id : blocks_ids_to_send) {
+    const BlockPtr & block = known_blocks.get(block_id);
+    if (block->is_pruned()) {
+      // We don't have its txs anymore. Sending it without them would make the peer think they're not confirmed
+      LOG("can't send pruned block %u to %d", block_id, peer.id);
+      pruned_blocks_requested++;
+      InsertSorted(peer.objects_not_found, block_id);
+      continue;
+    }
+    set_known_by_peer(peer, block_id, true);
+    LOG("sending block %u to %d", block_id, peer.id);
+    send_message(peer, new BlockMessage(block));
   }
 }
 
-void Node::send_transactions(int peer_id)
+void Node::send_transactions(PeerState & peer)
 {
   // We will let the peer know about recent unconfirmed txs (but we won't send the txs that we know the peer already knows)
-  std::map<long, Transaction> txs_to_send = IntersectMaps(mempool, objects_to_send_to_peer[peer_id]);
-  txs_known_by_peer[peer_id] = JoinMaps(txs_known_by_peer[peer_id], txs_to_send);
+  std::vector<object_id_t> txs_to_send;
+  IntersectInto(txs_to_send, mempool.get_ids(), peer.objects_to_send);
+  for (auto const& tx_id : txs_to_send) {
+    set_known_by_peer(peer, tx_id, false);
+  }
   if (txs_to_send.size() > 0) {
-    sent_messages++;
-    for (auto const& idAndTransaction : txs_to_send) {
-      LOG("sending %ld tx to %d", idAndTransaction.first, peer_id);
+    for (auto const& tx_id : txs_to_send) {
+      LOG("sending %u tx to %d", tx_id, peer.id);
     }
-    Message *message = new Transactions(txs_to_send);
-    simgrid::s4u::MailboxPtr mbox = get_peer_outgoing_mailbox(peer_id);
-    mbox->put_init(message, message->get_size())->detach();
+    send_message(peer, new Transactions(std::move(txs_to_send)));
   }
 }
 
 // Here we're sending messages with the new inventory we know about
-void Node::inv(int peer_id)
+void Node::inv(PeerState & peer)
 {
-  std::map<long, e_inv_type> objects;
-  std::set<long> blocks_ids_to_include = DiffSets(blocks_ids_to_broadcast[peer_id], blocks_known_by_peer[peer_id], objects_to_send_to_peer[peer_id]);
-  std::set<long> txs_ids_to_include = DiffSets(txs_ids_to_broadcast[peer_id], txs_known_by_peer[peer_id], objects_to_send_to_peer[peer_id]);
-  for (std::set<long>::iterator it_block_id = blocks_ids_to_include.begin(); it_block_id != blocks_ids_to_include.end(); it_block_id++) {
-    objects.insert(std::make_pair(*it_block_id, INV_BLOCK));
-  }
-  for (std::set<long>::iterator it_tx_id = txs_ids_to_include.begin(); it_tx_id != txs_ids_to_include.end(); it_tx_id++) {
-    objects.insert(std::make_pair(*it_tx_id, INV_TX));
+  // Include what I have to announce to this peer, except what it's known to have or what I'm sending it anyway
+  int slot = get_slot(peer);
+  std::vector<object_id_t> blocks_ids_to_include;
+  std::vector<object_id_t> txs_ids_to_include;
+  for (auto const& id : peer.inventory_ids) {
+    const InventoryEntry* entry = find_inventory_entry(id);
+    if (entry != nullptr && entry->to_broadcast.test(slot) && !entry->known.test(slot) && !ContainsSorted(peer.objects_to_send, id)) {
+      (entry->is_block ? blocks_ids_to_include : txs_ids_to_include).push_back(id);
+    }
   }
-  if (objects.size() > 0) {
-    sent_messages++;
-    for (auto const& id : objects) {
-      DEBUG("informing %d of %ld", peer_id, id.first);
+  // Ids are in the order their bits were set, and may be repeated
+  std::sort(blocks_ids_to_include.begin(), blocks_ids_to_include.end());
+  blocks_ids_to_include.erase(std::unique(blocks_ids_to_include.begin(), blocks_ids_to_include.end()), blocks_ids_to_include.end());
+  std::sort(txs_ids_to_include.begin(), txs_ids_to_include.end());
+  txs_ids_to_include.erase(std::unique(txs_ids_to_include.begin(), txs_ids_to_include.end()), txs_ids_to_include.end());
+  if (blocks_ids_to_include.size() > 0 || txs_ids_to_include.size() > 0) {
+    for (auto const& id : blocks_ids_to_include) {
+      DEBUG("informing %d of %u", peer.id, id);
     }
-    Message *message = new Inv(objects);
-    simgrid::s4u::MailboxPtr mbox = get_peer_outgoing_mailbox(peer_id);
-    mbox->put_init(message, message->get_size())->detach();
+    for (auto const& id : txs_ids_to_include) {
+      DEBUG("informing %d of %u", peer.id, id);
+    }
+    send_message(peer, new Inv(std::move(blocks_ids_to_include), std::move(txs_ids_to_include)));
   }
 }
 
 // Here we're sending messages with the inventory we need from other peers
-void Node::getdata(int peer_id)
+void Node::getdata(PeerState & peer)
 {
   // In objects_to_request we may have removed some of the objects we initially needed (because we later got them in a block or tx)
   // so we first intersect the object ids we need with the ones we are going to request from our peer
-  std::set<long> filtered_objects = IntersectSets(objects_to_request_from_peer[peer_id], objects_to_request);
+  std::vector<object_id_t> filtered_objects;
+  IntersectInto(filtered_objects, peer.objects_to_request, objects_to_request);
   if (filtered_objects.size() > 0) {
     for (auto const& id : filtered_objects) {
-      DEBUG("requesting %ld from %d", id, peer_id);
+      DEBUG("requesting %u from %d", id, peer.id);
     }
-    sent_messages++;
-    Message *message = new GetData(filtered_objects);
-    simgrid::s4u::MailboxPtr mbox = get_peer_outgoing_mailbox(peer_id);
-    mbox->put_init(message, message->get_size())->detach();
+    send_message(peer, new GetData(std::move(filtered_objects)));
+  }
+}
+
+void Node::getblocks(PeerState & peer)
+{
+  std::vector<object_id_t> locator;
+  for (auto const& block_id : peer.blocks_to_fetch) {
+    // We may have received it in the meantime
+    if (!ContainsSorted(objects_to_request, block_id)) {
+      continue;
+    }
+    if (locator.empty()) {
+      locator = get_locator();
+    }
+    DEBUG("requesting %u and its missing ancestors from %d", block_id, peer.id);
+    send_message(peer, new GetBlocks(locator, block_id));
+  }
+}
+
+void Node::notfound(PeerState & peer)
+{
+  if (peer.objects_not_found.size() > 0) {
+    for (auto const& id : peer.objects_not_found) {
+      DEBUG("letting %d know I don't have %u", peer.id, id);
+    }
+    send_message(peer, new NotFound(peer.objects_not_found));
   }
 }
 
 // After a round of receiving and sending messages we need to clean-up some structures that we don't need anymore
-void Node::cleanup(int peer_id)
+void Node::cleanup(PeerState & peer)
 {
-  blocks_ids_to_broadcast[peer_id].clear();
-  blocks_known_by_peer[peer_id].clear();
-  txs_ids_to_broadcast[peer_id].clear();
-  txs_known_by_peer[peer_id].clear();
-  objects_to_send_to_peer[peer_id].clear();
-  objects_to_request_from_peer[peer_id].clear();
+  int slot = get_slot(peer);
+  for (auto const& id : peer.inventory_ids) {
+    InventoryEntry* entry = find_inventory_entry(id);
+    if (entry != nullptr) {
+      entry->to_broadcast.reset(slot);
+      entry->known.reset(slot);
+      release_inventory_entry_if_unused(*entry);
+    }
+  }
+  peer.inventory_ids.clear();
+  peer.objects_to_send.clear();
+  peer.blocks_to_fetch.clear();
+  peer.objects_not_found.clear();
+  peer.objects_to_request.clear();
+  peer.dirty = false;
 }
 
-bool Node::handle_block(int relayed_by_peer_id, Block *message, bool force_broadcast)
+bool Node::handle_block(int relayed_by_peer_id, const BlockPtr & block_ptr, bool force_broadcast)
 {
   bool new_work_to_do = false;
-  Block block = Block(*message);
+  const Block & block = *block_ptr;
   // Remove the received block from the objects to request I have pending
-  Erase(objects_to_request, block.get_id());
-  if ((known_blocks_ids.find(block.get_id()) == known_blocks_ids.end()) || force_broadcast) {
+  EraseSorted(objects_to_request, block.get_id());
+  if (!known_blocks_ids.contains(block.get_id()) || force_broadcast) {
     handle_new_block(relayed_by_peer_id, block);
     // I didn't know about this block, I need to check if it represents a new top for the blockchain
-    if (blockchain_tip_updated(relayed_by_peer_id, block) || force_broadcast) {
-      if (message->get_miner_id() == my_id) {
-        LOG("broadcasting %ld with height %d and parent %ld", message->get_id(), message->get_height(), message->get_parent_id());
+    if (blockchain_tip_updated(relayed_by_peer_id, block_ptr) || force_broadcast) {
+      if (block.get_miner_id() == my_id) {
+        LOG("broadcasting %u with height %d and parent %u", block.get_id(), block.get_height(), block.get_parent_id());
       }
       LOG(
-        "received a new block %ld from %d with %ld txs",
+        "received a new block %u from %d with %ld txs",
         block.get_id(),
         relayed_by_peer_id,
-        block.get_transactions_map().size()
+        block.get_transactions().size()
       );
       handle_blockchain_tip_updated(relayed_by_peer_id, block);
       // Since we found a new block we'll have to broadcast its hash to our peers
       new_work_to_do = true;
     } else {
       LOG(
-        "received a block %ld from %d with %ld txs which doesn't represent a new best chain",
+        "received a block %u from %d with %ld txs which doesn't represent a new best chain",
         block.get_id(),
         relayed_by_peer_id,
-        block.get_transactions_map().size()
+        block.get_transactions().size()
       );
     }
   } else {
     // When a block arrives we only need to do something only if we didn't
     // know about it before.
     LOG(
-      "received a known block %ld from %d with %ld transactions",
+      "received a known block %u from %d with %ld transactions",
       block.get_id(),
       relayed_by_peer_id,
-      block.get_transactions_map().size()
+      block.get_transactions().size()
     );
   }
-  handle_orphan_blocks(block);
+  // Orphans can only be connected once their parent is. Adopting them earlier would just put them back in the pool
+  if (known_blocks_ids.contains(block.get_id())) {
+    handle_orphan_blocks(block);
+  }
   return new_work_to_do;
 }
 
-void Node::handle_new_block(int relayed_by_peer_id, const Block & block)
+void Node::handle_new_block(int /*relayed_by_peer_id*/, const Block & block)
 {
   // Fill the shared map nodes_knowing_block that we use for debugging purposes
   if (nodes_knowing_block.find(block.get_id()) == nodes_knowing_block.end()) {
@@ -273,12 +611,10 @@ void Node::handle_new_block(int relayed_by_peer_id, const Block & block)
     nodes_knowing_block[block.get_id()]++;
   }
   // We need to advertise our peers about the new block we received
-  for (std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-    blocks_ids_to_broadcast[*it_id].insert(block.get_id());
-  }
+  announce_to_peers(block.get_id(), true);
   bool received_by_all = nodes_knowing_block[block.get_id()] == NODES_COUNT;
   if (received_by_all) {
-    DEBUG("BLOCK_RECEIVED_BY_ALL %ld", block.get_id());
+    DEBUG("BLOCK_RECEIVED_BY_ALL %u", block.get_id());
   }
 }
 
@@ -287,39 +623,42 @@ void Node::handle_blockchain_tip_updated(int relayed_by_peer_id, const Block & b
   // Set the new current network difficulty
   difficulty = block.get_network_difficulty();
   bool confirmed_by_all = nodes_knowing_block[block.get_id()] == NODES_COUNT;
-  for (auto const& idAndTransaction : block.get_transactions_map()) {
-    LOG("confirmed tx %ld in block %ld %s", idAndTransaction.first, block.get_id(), confirmed_by_all ? "FOR_ALL_NODES" : "");
+  const std::vector<object_id_t> & block_txs = block.get_transactions();
+  for (auto const& tx_id : block_txs) {
+    LOG("confirmed tx %u in block %u %s", tx_id, block.get_id(), confirmed_by_all ? "FOR_ALL_NODES" : "");
   }
-  // Remove from txs_ids_to_broadcast the ones that got confirmed in this block
-  for (std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-    txs_ids_to_broadcast[*it_id] = DiffSets(txs_ids_to_broadcast[*it_id], block.get_transactions_map());
+  // Stop announcing the txs that got confirmed in this block, and forget which peers know about them
+  for (auto const& tx_id : block_txs) {
+    InventoryEntry* entry = find_inventory_entry(tx_id);
+    if (entry != nullptr) {
+      entry->to_broadcast.clear();
+      entry->known.clear();
+      release_inventory_entry_if_unused(*entry);
+    }
   }
   // Now that we know of txs that got confirmed we need to evict them from our mempool
-  mempool = DiffMaps(mempool, block.get_transactions_map());
+  mempool.remove(block_txs);
   // Clean from the objects to requests any possible tx that we found about when we received the new block
-  objects_to_request = DiffSets(objects_to_request, block.get_transactions_map());
+  EraseAllOf(objects_to_request, block_txs);
   if (relayed_by_peer_id == my_id) {
     // I generated this block, so I'm a miner and I naturally want everyone to know
     // about this block as soon as possible
-    for (std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-      int peer_id = *it_id;
-      DEBUG("letting peer %d know about block %ld", peer_id, block.get_id());
-      objects_to_send_to_peer[peer_id].insert(block.get_id());
+    for (auto & peer : peers) {
+      DEBUG("letting peer %d know about block %u", peer.id, block.get_id());
+      InsertSorted(peer.objects_to_send, block.get_id());
+      mark_dirty(peer);
     }
   } else {
     // This is a block I didn't generate, so I have to add it to the list of blocks known
     // by the peer who created it and I need to simulate the validation time
-    blocks_known_by_peer[relayed_by_peer_id].insert(block.get_id());
+    PeerState & peer = get_peer(relayed_by_peer_id);
+    set_known_by_peer(peer, block.get_id(), true);
+    mark_dirty(peer);
     // Simulate the time we have to wait to validate this block
     double start = simgrid::s4u::Engine::get_clock();
     simgrid::s4u::this_actor::execute(validator_timer.get_flops_to_process_block(block));
     DEBUG("It took %f seconds to validate a block", simgrid::s4u::Engine::get_clock() - start);
   }
-  // Remove from the unconfirmed transactions known by our peers those confirmed in the block we just received
-  for(std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-    int peer_id = *it_id;
-    txs_known_by_peer[peer_id] = DiffMaps(txs_known_by_peer[peer_id], block.get_transactions_map());
-  }
   update_network_difficulty_if_needed(block);
 }
 
@@ -328,8 +667,8 @@ void Node::update_network_difficulty_if_needed(const Block & block)
     if ((block.get_height() % INTERVAL_BETWEEN_DIFFICULTY_RECALC_IN_BLOCKS) == 0) {
       double expected_time = INTERVAL_BETWEEN_DIFFICULTY_RECALC_IN_BLOCKS * INTERVAL_BETWEEN_BLOCKS_IN_SECONDS;
       // We substract 1 to simulate the off-by-one bug error in the reference client implementation
-      long known_block_id = known_blocks_ids_by_height.find(blockchain_height - (INTERVAL_BETWEEN_DIFFICULTY_RECALC_IN_BLOCKS - 1))->second;
-      double base_time = known_blocks.find(known_block_id)->second.get_time();
+      object_id_t known_block_id = known_blocks.get_ancestor(block.get_id(), block.get_height() - (INTERVAL_BETWEEN_DIFFICULTY_RECALC_IN_BLOCKS - 1));
+      double base_time = known_blocks.get(known_block_id)->get_time();
       double actual_time = block.get_time() - base_time;
       unsigned long long new_difficulty = block.get_network_difficulty() * expected_time / actual_time;
       LOG(
@@ -346,137 +685,176 @@ void Node::update_network_difficulty_if_needed(const Block & block)
     }
 }
 
-void Node::handle_orphan_blocks(Block block)
+void Node::handle_orphan_blocks(const Block & block)
 {
   // Check if this block is the parent of current orphan blocks
-  if (orphan_blocks.find(block.get_id()) != orphan_blocks.end()) {
-    std::vector<Block> orphans = orphan_blocks[block.get_id()];
-    orphan_blocks[block.get_id()].clear();
-    for(std::vector<Block>::iterator it_orphan = orphans.begin(); it_orphan != orphans.end(); it_orphan++) {
-      DEBUG(
-        "found parent %ld for %ld",
-        block.get_id(),
-        it_orphan->get_id()
-      );
-      Block orphan = *it_orphan;
-      handle_block(my_id, &orphan);
-    }
+  size_t orphans_count = orphans_to_adopt.size();
+  orphan_blocks.take_children(block.get_id(), orphans_to_adopt);
+  for (size_t i = orphans_count; i < orphans_to_adopt.size(); i++) {
+    DEBUG("found parent %u for %u", block.get_id(), orphans_to_adopt[i]->get_id());
   }
+  if (adopting_orphans) {
+    // We got here handling an orphan, the loop below will get to its children. This way a long chain of orphans
+    // doesn't need a long chain of calls
+    return;
+  }
+  adopting_orphans = true;
+  while (!orphans_to_adopt.empty()) {
+    BlockPtr orphan = std::move(orphans_to_adopt.back());
+    orphans_to_adopt.pop_back();
+    handle_block(my_id, orphan);
+  }
+  adopting_orphans = false;
 }
 
-bool Node::blockchain_tip_updated(int relayed_by_peer_id, Block block)
+bool Node::blockchain_tip_updated(int relayed_by_peer_id, const BlockPtr & block_ptr)
 {
-  if (known_blocks_ids.find(block.get_parent_id()) == known_blocks_ids.end()) {
-    orphan_blocks[block.get_parent_id()].push_back(block);
-    DEBUG("received orphan block %ld", block.get_id());
+  const Block & block = *block_ptr;
+  if (!known_blocks_ids.contains(block.get_parent_id())) {
+    bool is_new_orphan = orphan_blocks.add(block_ptr);
+    DEBUG("received orphan block %u", block.get_id());
+    if (!is_new_orphan || orphan_blocks.contains(block.get_parent_id())) {
+      // Either way we already requested what's missing for the parent
+      return false;
+    }
     // We have a block without its parent => request said block to the same peer, because if he
     // sent us this block is because he may have a chain with more proof of work than our current one
-    request_block(relayed_by_peer_id, block.get_parent_id());
+    if (GET_BLOCKS) {
+      request_missing_blocks(relayed_by_peer_id, block.get_parent_id());
+    } else {
+      request_block(relayed_by_peer_id, block.get_parent_id());
+    }
     return false;
   }
   known_blocks_ids.insert(block.get_id());
-  known_blocks.insert(std::make_pair(block.get_id(), block));
+  known_blocks.insert(block_ptr);
   // Remove the received block from any possible object to request
-  Erase(objects_to_request, block.get_id());
+  EraseSorted(objects_to_request, block.get_id());
   // Check if we found a new best chain. We will accept the new block if its accumulated difficulty is
   // greather than the current one, ie: it represents a new best chain
+  const Block & tip = *blockchain_tip_block;
   DEBUG(
-    "difficulty comparison %llu vs %llu. first with id %ld:%d second with id %ld:%d",
+    "difficulty comparison %llu vs %llu. first with id %u:%d second with id %u:%d",
     block.get_accumulated_difficulty(),
-    known_blocks[blockchain_tip].get_accumulated_difficulty(),
+    tip.get_accumulated_difficulty(),
     block.get_id(),
     block.get_height(),
-    known_blocks[blockchain_tip].get_id(),
-    known_blocks[blockchain_tip].get_height()
+    tip.get_id(),
+    tip.get_height()
   );
-  if (block.get_accumulated_difficulty() > known_blocks[blockchain_tip].get_accumulated_difficulty()) {
-    if (block.get_parent_id() != blockchain_tip) {
-      reorg_txs(block.get_id(), blockchain_tip);
+  if (block.get_accumulated_difficulty() > tip.get_accumulated_difficulty()) {
+    if (block.get_parent_id() != blockchain_tip && !reorg_txs(block.get_id(), blockchain_tip)) {
+      return false;
     }
     blockchain_tip = block.get_id();
+    blockchain_tip_block = block_ptr;
     blockchain_height = block.get_height();
-    known_blocks_ids_by_height.insert(std::make_pair(block.get_height(), block.get_id()));
     return true;
   } else {
     return false;
   }
 }
 
-// When a block reorganization occurs I need to "forget" about known transactions that
-// had got confirmed in the previous best chain. Then I need to learn/mark as confirmed
-// the transactions that I only appeared in the new best chain.
-void Node::reorg_txs(long new_tip_id, long old_tip_id)
+// When a block reorganization occurs I need to disconnect the blocks from the previous best chain, whose txs are
+// unconfirmed again and go back to my mempool, and then connect the blocks that only appear in the new best chain,
+// whose txs are now confirmed and known. Each block has the sorted list of its txs, so this is O(txs in the fork)
+bool Node::reorg_txs(object_id_t new_tip_id, object_id_t old_tip_id)
 {
-  long common_parent_id = find_common_parent_id(new_tip_id, old_tip_id);
-  long current_block_id = old_tip_id;
+  object_id_t common_parent_id = known_blocks.get_last_common_ancestor(new_tip_id, old_tip_id);
+  int common_parent_height = known_blocks.get(common_parent_id)->get_height();
+  if (common_parent_height < known_blocks.get_pruned_height()) {
+    // The txs of the blocks right after the fork are gone. The new block stays known, so it isn't requested again,
+    // and if its chain ends up being the highest one this node is reported as stuck (see Node::~Node())
+    LOG(
+      "refusing to reorganize blocks. new tip: %u, old tip: %u, common: %u at height %d, pruned up to height %d",
+      new_tip_id,
+      old_tip_id,
+      common_parent_id,
+      common_parent_height,
+      known_blocks.get_pruned_height()
+    );
+    refused_reorgs++;
+    return false;
+  }
+  object_id_t current_block_id = old_tip_id;
   int fork_length = 0;
-  std::set<long> known_txs_to_discard;
+  std::vector<object_id_t> txs_disconnected;
   while (current_block_id != common_parent_id) {
     ++fork_length;
-    Block block = known_blocks.find(current_block_id)->second;
-    known_txs_to_discard = JoinSets(known_txs_to_discard, block.get_transactions_map());
+    const Block & block = *known_blocks.get(current_block_id);
+    txs_disconnected.insert(txs_disconnected.end(), block.get_transactions().begin(), block.get_transactions().end());
     current_block_id = block.get_parent_id();
   }
-  known_txs_ids = DiffSets(known_txs_ids, known_txs_to_discard);
   current_block_id = new_tip_id;
-  std::set<long> known_txs_to_add;
+  std::vector<object_id_t> txs_connected;
   while (current_block_id != common_parent_id) {
-    Block block = known_blocks.find(current_block_id)->second;
-    known_txs_to_add = JoinSets(known_txs_to_add, block.get_transactions_map());
+    const Block & block = *known_blocks.get(current_block_id);
+    txs_connected.insert(txs_connected.end(), block.get_transactions().begin(), block.get_transactions().end());
     current_block_id = block.get_parent_id();
   }
-  known_txs_ids = JoinSets(known_txs_ids, known_txs_to_add);
+  std::sort(txs_disconnected.begin(), txs_disconnected.end());
+  std::sort(txs_connected.begin(), txs_connected.end());
+  // Txs confirmed in both chains stay confirmed
+  std::vector<object_id_t> txs_discarded;
+  std::vector<object_id_t> txs_added;
+  DiffInto(txs_discarded, txs_disconnected, txs_connected);
+  DiffInto(txs_added, txs_connected, txs_disconnected);
+  mempool.add(txs_discarded);
+  mempool.remove(txs_connected);
+  for (auto const& id : txs_added) {
+    learn_tx(id);
+  }
+  limit_mempool();
   if (common_parent_id != old_tip_id) {
     LOG(
-      "reorganizing blocks. new tip: %ld, old tip: %ld, common: %ld, fork length: %d, known txs discarded: %ld, known txs: added %ld",
+      "reorganizing blocks. new tip: %u, old tip: %u, common: %u, fork length: %d, known txs discarded: %ld, known txs: added %ld",
       new_tip_id,
       old_tip_id,
       common_parent_id,
       fork_length,
-      DiffSets(known_txs_to_discard, known_txs_to_add).size(),
-      DiffSets(known_txs_to_add, known_txs_to_discard).size()
+      txs_discarded.size(),
+      txs_added.size()
     );
   } else {
     LOG(
-      "reorganizing blocks. new tip: %ld, known txs discarded: %ld, known txs: added %ld",
+      "reorganizing blocks. new tip: %u, known txs discarded: %ld, known txs: added %ld",
       common_parent_id,
-      DiffSets(known_txs_to_discard, known_txs_to_add).size(),
-      DiffSets(known_txs_to_add, known_txs_to_discard).size()
+      txs_discarded.size(),
+      txs_added.size()
     );
   }
-}
-
-long Node::find_common_parent_id(long new_parent_tip_id, long old_parent_tip_id)
-{
-  std::set<long> parents_for_new_id = {new_parent_tip_id};
-  std::set<long> parents_for_old_id = {old_parent_tip_id};
-  while (IntersectSets(parents_for_new_id, parents_for_old_id).size() == 0) {
-    new_parent_tip_id = known_blocks.find(new_parent_tip_id)->second.get_parent_id();
-    old_parent_tip_id = known_blocks.find(old_parent_tip_id)->second.get_parent_id();
-    parents_for_new_id.insert(new_parent_tip_id);
-    parents_for_old_id.insert(old_parent_tip_id);
-  }
-  return *(IntersectSets(parents_for_new_id, parents_for_old_id).begin());
+  return true;
 }
 
 bool Node::handle_transactions(int relayed_by_peer_id, Transactions *message)
 {
-  std::map<long, Transaction> txs_we_didnt_know = DiffMaps(message->get_transactions_map(), known_txs_ids);
+  const std::vector<object_id_t> & txs = message->get_transactions();
+  std::vector<object_id_t> txs_we_didnt_know;
+  for (auto const& tx_id : txs) {
+    if (!knows_tx(tx_id)) {
+      txs_we_didnt_know.push_back(tx_id);
+    }
+  }
   // Remove the received txs from any possible object to request
-  objects_to_request = DiffSets(objects_to_request, txs_we_didnt_know);
-  for (auto const& idAndTransaction : txs_we_didnt_know) {
-    LOG("received tx %ld from %d", idAndTransaction.first, relayed_by_peer_id);
+  EraseAllOf(objects_to_request, txs_we_didnt_know);
+  for (auto const& tx_id : txs_we_didnt_know) {
+    LOG("received tx %u from %d", tx_id, relayed_by_peer_id);
   }
-  known_txs_ids = JoinMaps(known_txs_ids, message->get_transactions_map());
-  // The transactions to broadcast will now also include the ones I didn't know of before
-  for (std::vector<int>::iterator it_id = my_peers.begin(); it_id != my_peers.end(); it_id++) {
-    txs_ids_to_broadcast[*it_id] = JoinSets(txs_ids_to_broadcast[*it_id], txs_we_didnt_know);
+  for (auto const& tx_id : txs) {
+    learn_tx(tx_id);
   }
+  // The transactions to broadcast will now also include the ones I didn't know of before
+  announce_to_peers(txs_we_didnt_know, false);
   // The transactions I'm aware of now include the ones I just received
-  mempool = JoinMaps(mempool, message->get_transactions_map());
+  mempool.add(txs);
+  limit_mempool();
   if (relayed_by_peer_id != my_id) {
     // Now I need to update the txs that I know my peer knows about
-    txs_known_by_peer[relayed_by_peer_id] = JoinMaps(txs_known_by_peer[relayed_by_peer_id], message->get_transactions_map());
+    PeerState & peer = get_peer(relayed_by_peer_id);
+    for (auto const& tx_id : txs) {
+      set_known_by_peer(peer, tx_id, false);
+    }
+    mark_dirty(peer);
   }
   bool has_work_to_do = txs_we_didnt_know.size() > 0;
   if (has_work_to_do) {
@@ -488,80 +866,229 @@ bool Node::handle_transactions(int relayed_by_peer_id, Transactions *message)
   return has_work_to_do;
 }
 
+bool Node::knows_tx(object_id_t tx_id)
+{
+  if (!recent_txs_ids) {
+    return known_txs_ids.contains(tx_id);
+  }
+  bool known = mempool.contains(tx_id) || recent_txs_ids->contains(tx_id);
+  if (ENABLE_DEBUG) {
+    known_txs_lookups++;
+    bool known_exactly = known_txs_ids.contains(tx_id);
+    if (known && !known_exactly) {
+      known_txs_false_positives++;
+    } else if (!known && known_exactly) {
+      known_txs_false_negatives++;
+    }
+  }
+  return known;
+}
+
+void Node::learn_tx(object_id_t tx_id)
+{
+  if (recent_txs_ids) {
+    recent_txs_ids->insert(tx_id);
+  }
+  if (!recent_txs_ids || ENABLE_DEBUG) {
+    known_txs_ids.insert(tx_id);
+  }
+}
+
+void Node::forget_tx(object_id_t tx_id)
+{
+  if (!recent_txs_ids || ENABLE_DEBUG) {
+    known_txs_ids.erase(tx_id);
+  }
+}
+
+void Node::limit_mempool()
+{
+  evicted_txs_ids.clear();
+  if (MEMPOOL_EXPIRY > 0) {
+    mempool.expire(simgrid::s4u::Engine::get_clock() - MEMPOOL_EXPIRY, evicted_txs_ids);
+  }
+  if (MAX_MEMPOOL_SIZE > 0) {
+    mempool.trim_to_size(MAX_MEMPOOL_SIZE, evicted_txs_ids);
+  }
+  if (evicted_txs_ids.empty()) {
+    return;
+  }
+  std::sort(evicted_txs_ids.begin(), evicted_txs_ids.end());
+  for (auto const& tx_id : evicted_txs_ids) {
+    DEBUG("evicted tx %u from the mempool", tx_id);
+    forget_tx(tx_id);
+    recently_evicted_txs_ids->insert(tx_id);
+  }
+  // There's no point in letting my peers know about txs I'm not going to send them
+  for (auto const& tx_id : evicted_txs_ids) {
+    InventoryEntry* entry = find_inventory_entry(tx_id);
+    if (entry != nullptr) {
+      entry->to_broadcast.clear();
+      release_inventory_entry_if_unused(*entry);
+    }
+  }
+}
+
+bool Node::was_recently_evicted(object_id_t tx_id)
+{
+  return recently_evicted_txs_ids && recently_evicted_txs_ids->contains(tx_id);
+}
+
 // Other peer is informing us about some inventory he knows about. If we don't know about some object we're
 // going to request it from said peer
 void Node::handle_inv(int relayed_by_peer_id, Inv *message)
 {
-  std::map<long, e_inv_type> objects_received = message->get_objects();
-  for(std::map<long, e_inv_type>::iterator it_object = objects_received.begin(); it_object != objects_received.end(); it_object++) {
-    // Add the objects we don't know about yet only if we are not already going to ask for it to another peer
-    if (objects_to_request.find(it_object->first) == objects_to_request.end()) {
-      switch (it_object->second) {
-        case INV_BLOCK:
-          blocks_known_by_peer[relayed_by_peer_id].insert(it_object->first);
-          if (known_blocks_ids.find(it_object->first) == known_blocks_ids.end()) {
-            request_block(relayed_by_peer_id, it_object->first);
-          }
-          break;
-        case INV_TX:
-          txs_known_by_peer[relayed_by_peer_id].insert(it_object->first);
-          if (known_txs_ids.find(it_object->first) == known_txs_ids.end()) {
-            DEBUG(
-              "need to request tx %ld from %d",
-              it_object->first,
-              relayed_by_peer_id
-            );
-            // I don't know about this tx => I will ask the peer to send it to me
-            objects_to_request.insert(it_object->first);
-            objects_to_request_from_peer[relayed_by_peer_id].insert(it_object->first);
-          }
-          break;
-        default:
-          THROW_IMPOSSIBLE;
+  PeerState & peer = get_peer(relayed_by_peer_id);
+  mark_dirty(peer);
+  // Add the objects we don't know about yet only if we are not already going to ask for it to another peer
+  for (auto const& block_id : message->get_blocks_ids()) {
+    if (!ContainsSorted(objects_to_request, block_id)) {
+      set_known_by_peer(peer, block_id, true);
+      if (!known_blocks_ids.contains(block_id)) {
+        request_block(relayed_by_peer_id, block_id);
+      }
+    }
+  }
+  for (auto const& tx_id : message->get_txs_ids()) {
+    if (!ContainsSorted(objects_to_request, tx_id)) {
+      set_known_by_peer(peer, tx_id, false);
+      if (!knows_tx(tx_id) && !was_recently_evicted(tx_id)) {
+        DEBUG(
+          "need to request tx %u from %d",
+          tx_id,
+          relayed_by_peer_id
+        );
+        // I don't know about this tx => I will ask the peer to send it to me
+        InsertSorted(objects_to_request, tx_id);
+        InsertSorted(peer.objects_to_request, tx_id);
       }
     }
   }
 }
 
-void Node::request_block(int relayed_by_peer_id, long block_id) {
+void Node::request_block(int relayed_by_peer_id, object_id_t block_id) {
+  if (relayed_by_peer_id == my_id) {
+    // There's no peer to ask. Don't mark it as requested either, so we ask the next peer that announces it
+    DEBUG("need block %u but there's no peer to request it from", block_id);
+    return;
+  }
   // I don't know about this block => I will ask the peer to send it to me
   DEBUG(
-    "need to request block %ld from %d",
+    "need to request block %u from %d",
+    block_id,
+    relayed_by_peer_id
+  );
+  InsertSorted(objects_to_request, block_id);
+  PeerState & peer = get_peer(relayed_by_peer_id);
+  InsertSorted(peer.objects_to_request, block_id);
+  mark_dirty(peer);
+}
+
+void Node::request_missing_blocks(int relayed_by_peer_id, object_id_t block_id)
+{
+  DEBUG(
+    "need to request block %u and its missing ancestors from %d",
     block_id,
     relayed_by_peer_id
   );
-  objects_to_request.insert(block_id);
-  objects_to_request_from_peer[relayed_by_peer_id].insert(block_id);
+  InsertSorted(objects_to_request, block_id);
+  PeerState & peer = get_peer(relayed_by_peer_id);
+  InsertSorted(peer.blocks_to_fetch, block_id);
+  mark_dirty(peer);
+}
+
+std::vector<object_id_t> Node::get_locator()
+{
+  std::vector<object_id_t> locator;
+  int step = 1;
+  for (int height = blockchain_height; height > 0; height -= step) {
+    locator.push_back(known_blocks.get_ancestor(blockchain_tip, height));
+    if (locator.size() > 10) {
+      step *= 2;
+    }
+  }
+  locator.push_back(0);
+  return locator;
+}
+
+// Other peer is asking for the blocks of a chain it's missing
+void Node::handle_getblocks(int relayed_by_peer_id, GetBlocks *message)
+{
+  object_id_t stop_id = message->get_stop_id();
+  if (!known_blocks_ids.contains(stop_id)) {
+    DEBUG("node %d requested the chain of %u, which I don't know", relayed_by_peer_id, stop_id);
+    PeerState & peer = get_peer(relayed_by_peer_id);
+    InsertSorted(peer.objects_not_found, stop_id);
+    mark_dirty(peer);
+    return;
+  }
+  // The locator goes from the tip of the peer down, so the first block in the chain of stop_id is where it forks.
+  // At worst, that's the genesis block
+  int fork_height = 0;
+  for (auto const& block_id : message->get_locator()) {
+    if (known_blocks_ids.contains(block_id)) {
+      int height = known_blocks.get(block_id)->get_height();
+      if (height <= known_blocks.get(stop_id)->get_height() && known_blocks.get_ancestor(stop_id, height) == block_id) {
+        fork_height = height;
+        break;
+      }
+    }
+  }
+  std::vector<object_id_t> blocks_ids;
+  for (object_id_t block_id = stop_id; known_blocks.get(block_id)->get_height() > fork_height; block_id = known_blocks.get(block_id)->get_parent_id()) {
+    blocks_ids.push_back(block_id);
+  }
+  DEBUG("node %d requested the chain of %u, sending %zu blocks", relayed_by_peer_id, stop_id, blocks_ids.size());
+  // Children have greater ids than their parents, so once sorted they will be sent parents first
+  std::sort(blocks_ids.begin(), blocks_ids.end());
+  PeerState & peer = get_peer(relayed_by_peer_id);
+  MergeInto(peer.objects_to_send, blocks_ids);
+  mark_dirty(peer);
 }
 
 // Other peer is asking that we send him inventory that we know about
 void Node::handle_getdata(int relayed_by_peer_id, GetData *message)
 {
   for (auto const& id : message->get_objects()) {
-    DEBUG("node %d requested %ld", relayed_by_peer_id, id);
+    DEBUG("node %d requested %u", relayed_by_peer_id, id);
   }
-  objects_to_send_to_peer[relayed_by_peer_id] = JoinSets(objects_to_send_to_peer[relayed_by_peer_id], message->get_objects());
+  PeerState & peer = get_peer(relayed_by_peer_id);
+  MergeInto(peer.objects_to_send, message->get_objects());
+  mark_dirty(peer);
 }
 
-long Node::compute_mempool_size()
+// Other peer is letting us know it doesn't have some objects we requested
+void Node::handle_notfound(int relayed_by_peer_id, NotFound *message)
 {
-  long result = 0;
-  typename std::map<long, Transaction>::const_iterator it = mempool.begin();
-  while (it != mempool.end()) {
-    result += it->second.get_size();
-    ++it;
+  for (auto const& id : message->get_objects()) {
+    DEBUG("node %d doesn't have %u", relayed_by_peer_id, id);
   }
-  return result;
+  // Stop waiting for them, so we request them from the next peer that announces them
+  EraseAllOf(objects_to_request, message->get_objects());
+}
+
+long Node::compute_mempool_size()
+{
+  return mempool.get_size_in_bytes();
 }
 
 simgrid::s4u::MailboxPtr Node::get_peer_incoming_mailbox(int peer_id)
 {
   std::string mboxName = std::string("from:") + std::to_string(peer_id) + "-to:" + std::to_string(my_id);
+  mailbox_lookups++;
   return simgrid::s4u::Mailbox::by_name(mboxName);
 }
 
 simgrid::s4u::MailboxPtr Node::get_peer_outgoing_mailbox(int peer_id)
 {
   std::string mboxName = std::string("from:") + std::to_string(my_id) + "-to:" + std::to_string(peer_id);
+  mailbox_lookups++;
+  return simgrid::s4u::Mailbox::by_name(mboxName);
+}
+
+simgrid::s4u::MailboxPtr Node::get_inbox(int node_id)
+{
+  std::string mboxName = std::string("to:") + std::to_string(node_id);
+  mailbox_lookups++;
   return simgrid::s4u::Mailbox::by_name(mboxName);
 }
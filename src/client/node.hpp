@@ -2,9 +2,61 @@
 #define NODE_HPP
 
 #include "base_node.hpp"
+#include "mempool.hpp"
+#include "orphan_pool.hpp"
 #include "shared_data.hpp"
 #include "validator_timer.hpp"
+#include "../rolling_bloom_filter.hpp"
 #include "../trace/trace_item.hpp"
+#include <memory>
+#include <unordered_map>
+
+// Everything a node keeps about one of its peers. Containers are cleared but never freed between rounds, so
+// they keep their capacity
+struct PeerState
+{
+  // The id of the peer
+  int id;
+  // The mailbox where this peer sends me messages, resolved once in init_from_args. Not used with --single-inbox
+  simgrid::s4u::MailboxPtr incoming_mailbox;
+  // The mailbox where I send messages to this peer (its inbox with --single-inbox), resolved once in init_from_args
+  simgrid::s4u::MailboxPtr outgoing_mailbox;
+  // Note: every container of ids is a sorted std::vector, so we can use the set operations from aux_functions.hpp
+  // What has to be announced to this peer, and what it's known to have, is kept in Node::inventory instead
+  // The objects ids I need to request from this peer
+  std::vector<object_id_t> objects_to_request;
+  // The objects ids I need to send to this peer
+  std::vector<object_id_t> objects_to_send;
+  // The ids of the entries of Node::inventory where the bit of this peer was set in the current round, so inv()
+  // and cleanup() visit only those instead of the whole inventory. Their bits may have been cleared since, and
+  // an id may be repeated
+  std::vector<object_id_t> inventory_ids;
+  // With --get-blocks, the ids of the blocks I need to request from this peer along with their missing ancestors
+  std::vector<object_id_t> blocks_to_fetch;
+  // The objects ids this peer requested that I can't send
+  std::vector<object_id_t> objects_not_found;
+  // With --coalesce-messages, the messages for this peer from the current round, to be sent together
+  std::vector<Message*> messages_to_coalesce;
+  // Whether any of the containers above is not empty, or the bit of this peer is set in any entry of Node::inventory,
+  // ie: there may be something to send to this peer. Nodes skip the peers that aren't dirty when sending messages
+  bool dirty = false;
+  // When running with --event-driven, this is the pending reception posted on the incoming mailbox of this peer
+  simgrid::s4u::CommPtr pending_receive;
+  // When running with --event-driven, this is where pending_receive will leave its message
+  void* pending_payload = nullptr;
+};
+
+// What a node keeps, during a round, about an object (block or tx) it may have to announce to its peers. Peers are
+// identified by their slot, so checking or updating what we know about a peer and an object is a single bit operation
+struct InventoryEntry
+{
+  object_id_t id;
+  bool is_block;
+  // The peers that I need to let know about this object in new inventory messages
+  PeerMask to_broadcast;
+  // The peers I know know about this object (so I don't notify them again about it)
+  PeerMask known;
+};
 
 /*
 * This class represents a node (a miner is also a node with additional specialization) that knows how to:
@@ -19,23 +71,31 @@ class Node : public BaseNode
 public:
   explicit Node() {};
   explicit Node(std::vector<std::string> args);
+  ~Node();
   double get_next_activity_time();
 
 protected:
   // current network difficulty
   unsigned long long difficulty;
-  // set of transactions ids we know about
-  std::set<long> known_txs_ids;
-  // map of unconfirmed transactions: <txid, tx>
-  std::map<long, Transaction> mempool;
+  // set of transactions ids we know about. With --rolling-bloom-filter it's only kept with --debug, to check the filter
+  IdSet known_txs_ids;
+  // With --rolling-bloom-filter, the txs we learnt about most recently. Along with the mempool, they're the txs we know about
+  std::unique_ptr<RollingBloomFilter> recent_txs_ids;
+  // unconfirmed transactions, their data lives in txs_table
+  Mempool mempool;
+  // Scratch space for limit_mempool(), so it doesn't need to allocate every time
+  std::vector<object_id_t> evicted_txs_ids;
+  // With --max-mempool or --mempool-expiry, the txs we evicted from the mempool most recently, so we don't request
+  // them again when a peer announces them, like the reference client does with the txs it rejects
+  std::unique_ptr<RollingBloomFilter> recently_evicted_txs_ids;
   // the block id corresponding to the top of the best chain so far
-  long blockchain_tip = 0;
+  object_id_t blockchain_tip = 0;
+  // the block at the top of the best chain so far, so we don't need to look it up
+  BlockPtr blockchain_tip_block;
   // the block height corresponding to the top of the best chain so far
   int blockchain_height = 0;
-  // map of blocks ids we know about indexed by their height in the blockchain
-  std::map<int, long> known_blocks_ids_by_height = {{0, 0}};
-  // set of blocks ids we know about
-  std::set<long> known_blocks_ids = {0};
+  // set of blocks ids we know about (initialized with the genesis block in init_from_args)
+  IdSet known_blocks_ids;
 
   // Will initialized the structures for this node by parsing the provided arguments
   void init_from_args(std::vector<std::string> args);
@@ -44,43 +104,59 @@ protected:
   // Will generate txs if it's a node or txs/blocks if it's a miner. As a precondition the current
   // time has to be at least the same as the next_activity_time
   void generate_activity();
-  // For each peer will process at most 1 message from it and send any pending messages to it.
+  // For each peer will process at most MAX_MESSAGES_PER_PEER messages from it and send any pending messages to it.
   // Returns true if it had work to do
   bool handle_messages();
+  // Blocks until a message from any peer is ready to be handled or until timeout seconds have passed.
+  // Only used when running with --event-driven
+  void wait_for_messages(double timeout);
   // Given the list of unconfirmed txs returns the size in bytes of that set
   long compute_mempool_size();
-  // Returns the mailbox to send messages to a given peer
+  // Looks up by name the mailbox to receive messages from a given peer. Use PeerState::incoming_mailbox instead
   simgrid::s4u::MailboxPtr get_peer_incoming_mailbox(int peer_id);
-  // Returns the mailbox to receive messages from a given peer
+  // Looks up by name the mailbox to send messages to a given peer. Use PeerState::outgoing_mailbox instead
   simgrid::s4u::MailboxPtr get_peer_outgoing_mailbox(int peer_id);
+  // Looks up by name the mailbox where a given node receives the messages from all its peers with --single-inbox
+  simgrid::s4u::MailboxPtr get_inbox(int node_id);
   // Handles a block relayed by relayed_by_peer_id. Returns true if it was a new block for this node.
-  virtual bool handle_block(int relayed_by_peer_id, Block *message, bool force_broadcast = false);
+  virtual bool handle_block(int relayed_by_peer_id, const BlockPtr & block, bool force_broadcast = false);
   // Handles a blocks this node didn't know about
   void handle_new_block(int relayed_by_peer_id, const Block & block);
   // Handles the event when the tip of the blockchain needs to change with the provided block
   void handle_blockchain_tip_updated(int relayed_by_peer_id, const Block & block);
-  // Creats a transaction object. It's called from the generate_activity() method
-  Transaction create_transaction(long size, long fee_per_byte, double confirmed);
+  // Creates a transaction in txs_table and returns its id. It's called from the generate_activity() method
+  object_id_t create_transaction(long size, long fee_per_byte, double confirmed);
 // Will handle the situation where the best blockchain will become that one identified by block
-  bool blockchain_tip_updated(int relayed_by_peer_id, Block block);
+  bool blockchain_tip_updated(int relayed_by_peer_id, const BlockPtr & block);
 
 private:
-  // The ids of the blocks I received and that I know must be included in new inventory messages for my peers
-  std::map<int, std::set<long>> blocks_ids_to_broadcast;
-  // The blocks ids I know that my peers know about (so I don't notify them again about them)
-  std::map<int, std::set<long>> blocks_known_by_peer;
-  // The ids of txs I received and that I know must be included in new inventory messages for my peers
-  std::map<int, std::set<long>> txs_ids_to_broadcast;
-  // The txs ids I know my peers know about (so I don't notify them again about them)
-  std::map<int, std::set<long>> txs_known_by_peer;
+  // The state of each one of my peers, in the same order as my_peers. We call the position of a peer here its slot
+  std::vector<PeerState> peers;
+  // The slot in peers of each one of my peers, by peer id
+  std::unordered_map<int, int> peer_slots;
+  // The slots of the peers marked as dirty, in no particular order
+  std::vector<int> dirty_peers;
+  // The objects I may have to announce to my peers in the current round. Entries are released as soon as their
+  // masks get empty, leaving their slot for the next entry, so the inventory never needs to be compacted
+  std::vector<InventoryEntry> inventory;
+  // The position in inventory of each entry in use, by object id
+  std::unordered_map<object_id_t, int> inventory_slots;
+  // The positions in inventory of the entries released, to be reused
+  std::vector<int> free_inventory_slots;
+  // With --single-inbox, the mailbox where I receive the messages from all my peers
+  simgrid::s4u::MailboxPtr inbox;
+  // With --single-inbox and --event-driven, the pending reception posted on my inbox
+  simgrid::s4u::CommPtr inbox_pending_receive;
+  // With --single-inbox and --event-driven, where inbox_pending_receive will leave its message
+  void* inbox_pending_payload = nullptr;
   // These are blocks that I received but for which I still don't know about their parents
-  std::map<long, std::vector<Block>> orphan_blocks;
+  OrphanPool orphan_blocks = OrphanPool(MAX_ORPHAN_BLOCKS);
+  // Orphan blocks whose parent just arrived, waiting to be handled. The last one goes first
+  std::vector<BlockPtr> orphans_to_adopt;
+  // Whether I'm already going through orphans_to_adopt, so handling one of them doesn't start over
+  bool adopting_orphans = false;
   // This is the set of ids (blocks ids or txs ids) that I need to request from my peers
-  std::set<long> objects_to_request;
-  // I keep a list of the objects ids I need to request from each peer
-  std::map<int, std::set<long>> objects_to_request_from_peer;
-  // I keep a list of object ids I need to send to each peer
-  std::map<int, std::set<long>> objects_to_send_to_peer;
+  std::vector<object_id_t> objects_to_request;
   // This is the next activity item that I will use to generate a tx and broadcast it to my peers
   TraceItem next_activity_item;
   // This is the time where I should generate the next transaction (based on next_activity_item)
@@ -94,41 +170,106 @@ private:
   bool using_trace;
   // If I'm generating the txs following a real blockchain trace, this is where I store the index of
   // the next acitivity item that need to be user to create the new tx
-  int current_trace_index = 0;
+  size_t current_trace_index = 0;
   // If I'm generating the txs following a real blockchain trace, this is where I store the trace information
   std::vector<TraceItem> trace;
 
-  // Checks fromt the logic peers of this node at most one message per each peer, process it, and returns
-  // true if it processed at least one message
-  bool receive_messages_from_peer(int peer_id);
-  // Sends any pending message it may have to peer identified with id = peer_id
-  void send_messages_to_peer(int peer_id);
-  // Performs some housekeeping cleaning operations after a round of sending/receiving messages
-  void cleanup(int peer_id);
+  // Returns the state of the peer identified by peer_id, which must be one of my peers
+  PeerState & get_peer(int peer_id);
+  // Returns the slot of the given peer, ie: its position in peers
+  int get_slot(const PeerState & peer) const
+  {
+    return &peer - peers.data();
+  }
+  // Adds the peer to the dirty_peers worklist. Must be called every time something is added to its containers
+  void mark_dirty(PeerState & peer);
+  // Returns the inventory entry of the given object, creating it if there's none
+  InventoryEntry & get_inventory_entry(object_id_t id, bool is_block);
+  // Returns the inventory entry of the given object, or nullptr if there's none
+  InventoryEntry* find_inventory_entry(object_id_t id);
+  // Adds the entry to the inventory_ids of the peer in the given slot, unless its bit is already set in the entry
+  void track_inventory_entry(const InventoryEntry & entry, int slot);
+  // Marks the given objects to be announced to all my peers, which become dirty
+  void announce_to_peers(object_id_t id, bool is_block);
+  void announce_to_peers(const std::vector<object_id_t> & ids, bool is_block);
+  // Records that the given peer knows about the given object. It doesn't mark the peer as dirty
+  void set_known_by_peer(PeerState & peer, object_id_t id, bool is_block);
+  // Releases the entry if it has no peer left to announce it to nor known to have it. Its slot in inventory will be
+  // reused by the next entry created
+  void release_inventory_entry_if_unused(InventoryEntry & entry);
+  // Process at most MAX_MESSAGES_PER_PEER messages from the given peer. Returns true if it processed at least one
+  // message or there are more left
+  bool receive_messages_from_peer(PeerState & peer);
+  // With --single-inbox, process the messages ready in my inbox, MAX_MESSAGES_PER_PEER times as many as I have
+  // peers at most. Returns true if it processed at least one message or there are more left
+  bool receive_messages_from_inbox();
+  // Returns the next message from the given mailbox if there's one ready, nullptr otherwise. With --event-driven
+  // it keeps a reception posted in pending_receive, whose message is left in pending_payload
+  void* get_ready_message(simgrid::s4u::MailboxPtr mbox, simgrid::s4u::CommPtr & pending_receive, void* & pending_payload);
+  // Deletes the message left in pending_payload by a reception that completed but was never tested, if any
+  void release_pending_message(void* & pending_payload);
+  // Handles a message from peer_id and deletes it. Returns true if it was something new for this node
+  bool handle_message(int peer_id, Message *payload);
+  // Sends a message to the given peer. With --coalesce-messages it just keeps it until send_coalesced_messages()
+  void send_message(PeerState & peer, Message *message);
+  // With --coalesce-messages, sends together all the messages for the given peer from the current round
+  void send_coalesced_messages(PeerState & peer);
+  // Puts a message in the mailbox of the given peer
+  void put_message(PeerState & peer, Message *message);
+  // Sends any pending message it may have to the given peer
+  void send_messages_to_peer(PeerState & peer);
+  // Performs some housekeeping cleaning operations after a round of sending/receiving messages. Unmarks the peer as dirty
+  void cleanup(PeerState & peer);
   // Sets the simulation time when the next generation activity should happen for this node
   void do_set_next_activity_time();
   // Given a list of transactions, it process it and returns true if there was at least one we didn't know
   bool handle_transactions(int relayed_by_peer_id, Transactions *message);
+  // Returns true if I know about the given tx (it's in my mempool or I've seen it confirmed)
+  bool knows_tx(object_id_t tx_id);
+  // Remembers that I know about the given tx
+  void learn_tx(object_id_t tx_id);
+  // Forgets about the given tx. With --rolling-bloom-filter I can't, so I will just forget about it eventually
+  void forget_tx(object_id_t tx_id);
+  // Evicts from the mempool the expired txs and, if it's bigger than MAX_MEMPOOL_SIZE, the ones with the lowest fee
+  // per byte. Evicted txs are forgotten, but remembered as recently evicted so we don't request them again
+  void limit_mempool();
+  // Whether the tx is one of the ones we evicted from the mempool most recently
+  bool was_recently_evicted(object_id_t tx_id);
   // Given an inventory message from one of its peers, it will check if something needs to be done (eg: sending a MESSAGE_GETDATA)
   void handle_inv(int relayed_by_peer_id, Inv *message);
-  // Performs a block request to the peer identified by relayed_by_peer_id
-  void request_block(int relayed_by_peer_id, long block_id);
+  // Performs a block request to the peer identified by relayed_by_peer_id. Does nothing if that's me, as there's no
+  // peer to ask (the block will be requested when a peer announces it)
+  void request_block(int relayed_by_peer_id, object_id_t block_id);
+  // With --get-blocks, requests to the peer identified by relayed_by_peer_id the given block and every ancestor of
+  // it I don't know about, in a single message
+  void request_missing_blocks(int relayed_by_peer_id, object_id_t block_id);
+  // Returns the ids of blocks from my best chain to let a peer know where it forks from another chain: the last
+  // 11 blocks, then more and more spaced ones, down to the genesis block, like the reference client
+  std::vector<object_id_t> get_locator();
+  // Given a MESSAGE_GETBLOCKS will register the missing blocks to then send them to the peer identified by relayed_by_peer_id
+  void handle_getblocks(int relayed_by_peer_id, GetBlocks *message);
   // Given a MESSAGE_GETDATA will register the request to then send the requested objects to the peer identified by relayed_by_peer_id
   void handle_getdata(int relayed_by_peer_id, GetData *message);
-  // Will send any pending blocks to the peer identified with peer_id. These are blocks the peer didn't know about
-  void send_blocks(int peer_id);
-  // Will send any pending txs to the peer identified with peer_id. These are txs the peer didn't know about
-  void send_transactions(int peer_id);
-  // Will send a MESSAGE_INV to the peer identified with peer_id letting it know about some object it may not know about
-  void inv(int peer_id);
-  // Will send a MESSAGE_GETDATA to the peer identified with peer_id requesting some objects we need from it
-  void getdata(int peer_id);
+  // Given a MESSAGE_NOTFOUND will forget we requested those objects, so we request them again when a peer announces them
+  void handle_notfound(int relayed_by_peer_id, NotFound *message);
+  // Will send any pending blocks to the given peer. These are blocks the peer didn't know about
+  void send_blocks(PeerState & peer);
+  // Will send any pending txs to the given peer. These are txs the peer didn't know about
+  void send_transactions(PeerState & peer);
+  // Will send a MESSAGE_INV to the given peer letting it know about some object it may not know about
+  void inv(PeerState & peer);
+  // Will send a MESSAGE_GETDATA to the given peer requesting some objects we need from it
+  void getdata(PeerState & peer);
+  // With --get-blocks, will send a MESSAGE_GETBLOCKS to the given peer for each block we need from it with its ancestors
+  void getblocks(PeerState & peer);
+  // Will send a MESSAGE_NOTFOUND to the given peer with the objects it requested that we can't send
+  void notfound(PeerState & peer);
   // Will hanble blocks for which we don't know their parents
-  void handle_orphan_blocks(Block block);
-  // Will reorganize the confirmed/unconfirmed txs after a change in the blockchain tip
-  void reorg_txs(long new_tip_id, long old_tip_id);
-  // Given 2 blocks identifiers, it will return the most recent common parent for them
-  long find_common_parent_id(long new_tip_id, long old_tip_id);
+  void handle_orphan_blocks(const Block & block);
+  // Will reorganize the confirmed/unconfirmed txs after a change in the blockchain tip, returning to the mempool
+  // the txs that are no longer confirmed. With --prune-depth, it refuses to do it (returning false) if the chains fork
+  // below the pruned blocks
+  bool reorg_txs(object_id_t new_tip_id, object_id_t old_tip_id);
   // Every INTERVAL_BETWEEN_DIFFICULTY_RECALC_IN_BLOCKS we need to update network difficulty
   // We use the following function to check if we're in that situation and update the difficulty
   // accordingly
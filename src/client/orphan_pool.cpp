@@ -0,0 +1,58 @@
+#include "orphan_pool.hpp"
+#include <algorithm>
+
+bool OrphanPool::add(const BlockPtr & block)
+{
+  if (contains(block->get_id())) {
+    return false;
+  }
+  if (orphans.size() >= max_size) {
+    evict_oldest();
+  }
+  orphans[block->get_id()] = Orphan{block, next_age};
+  ids_by_age[next_age++] = block->get_id();
+  ids_by_parent[block->get_parent_id()].push_back(block->get_id());
+  return true;
+}
+
+void OrphanPool::take_children(object_id_t parent_id, std::vector<BlockPtr> & children)
+{
+  std::unordered_map<object_id_t, std::vector<object_id_t>>::iterator it = ids_by_parent.find(parent_id);
+  if (it == ids_by_parent.end()) {
+    return;
+  }
+  for (auto it_id = it->second.rbegin(); it_id != it->second.rend(); ++it_id) {
+    std::unordered_map<object_id_t, Orphan>::iterator it_orphan = orphans.find(*it_id);
+    children.push_back(it_orphan->second.block);
+    ids_by_age.erase(it_orphan->second.age);
+    orphans.erase(it_orphan);
+  }
+  ids_by_parent.erase(it);
+}
+
+void OrphanPool::evict_oldest()
+{
+  std::map<unsigned long, object_id_t>::iterator it_oldest = ids_by_age.begin();
+  object_id_t block_id = it_oldest->second;
+  object_id_t parent_id = orphans.find(block_id)->second.block->get_parent_id();
+  std::vector<object_id_t> & siblings = ids_by_parent[parent_id];
+  siblings.erase(std::find(siblings.begin(), siblings.end(), block_id));
+  if (siblings.empty()) {
+    ids_by_parent.erase(parent_id);
+  }
+  // Its descendants go too. They would wait for it forever, as it was already requested and it's still the parent
+  // of orphans, so it wouldn't be requested again when the next block of their chain arrives
+  std::vector<object_id_t> ids_to_evict = {block_id};
+  while (!ids_to_evict.empty()) {
+    block_id = ids_to_evict.back();
+    ids_to_evict.pop_back();
+    std::unordered_map<object_id_t, Orphan>::iterator it_orphan = orphans.find(block_id);
+    ids_by_age.erase(it_orphan->second.age);
+    orphans.erase(it_orphan);
+    std::unordered_map<object_id_t, std::vector<object_id_t>>::iterator it_children = ids_by_parent.find(block_id);
+    if (it_children != ids_by_parent.end()) {
+      ids_to_evict.insert(ids_to_evict.end(), it_children->second.begin(), it_children->second.end());
+      ids_by_parent.erase(it_children);
+    }
+  }
+}
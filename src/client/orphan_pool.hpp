@@ -0,0 +1,52 @@
+#ifndef ORPHAN_POOL_HPP
+#define ORPHAN_POOL_HPP
+
+#include "../message.hpp"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/*
+* The blocks a node received but can't connect yet because it doesn't know about their parents. It keeps handles to
+* the shared blocks, indexed by their parents so they can be taken as soon as the parent arrives. It holds at most
+* max_size blocks: when it's full, the block that has been waiting the longest is evicted to make room for new ones,
+* along with the orphans that descend from it.
+*/
+class OrphanPool
+{
+public:
+  explicit OrphanPool(size_t max_size) : max_size(max_size) {}
+  // Adds a block whose parent is unknown. Returns false if it was already in the pool
+  bool add(const BlockPtr & block);
+  bool contains(object_id_t block_id) const
+  {
+    return orphans.find(block_id) != orphans.end();
+  }
+  // Takes out of the pool the blocks whose parent is parent_id and adds them to children, in the reverse order
+  // they were added to the pool (so popping them from the back of children gives them in arrival order)
+  void take_children(object_id_t parent_id, std::vector<BlockPtr> & children);
+
+  size_t size() const
+  {
+    return orphans.size();
+  }
+private:
+  struct Orphan
+  {
+    BlockPtr block;
+    // Order in which it was added, lower numbers were added before
+    unsigned long age;
+  };
+  size_t max_size;
+  unsigned long next_age = 0;
+  std::unordered_map<object_id_t, Orphan> orphans;
+  // Ids of the orphans, from the one that has been waiting the longest
+  std::map<unsigned long, object_id_t> ids_by_age;
+  // Ids of the orphans waiting for each parent, in the order they arrived
+  std::unordered_map<object_id_t, std::vector<object_id_t>> ids_by_parent;
+
+  // Evicts the oldest orphan and its descendants
+  void evict_oldest();
+};
+
+#endif /* ORPHAN_POOL_HPP */
@@ -0,0 +1,49 @@
+#include "scheduler.hpp"
+#include "simgrid/s4u.hpp"
+
+Scheduler::Scheduler(unsigned int nodes_count) : awake_nodes(nodes_count)
+{
+}
+
+void Scheduler::message_sent()
+{
+  messages_in_flight++;
+}
+
+void Scheduler::message_received()
+{
+  messages_in_flight--;
+}
+
+double Scheduler::get_sleep_duration(int node_id, double next_activity_time, double sleep_duration)
+{
+  set_next_activity_time(node_id, next_activity_time);
+  awake_nodes--;
+  if ((messages_in_flight > 0) || (awake_nodes > 0)) {
+    return sleep_duration;
+  }
+  // The network is quiescent: nothing will happen until the earliest activity of any node
+  double sleep_until_global_activity = next_activities.begin()->first - simgrid::s4u::Engine::get_clock();
+  return std::max(sleep_duration, sleep_until_global_activity);
+}
+
+void Scheduler::node_woke_up()
+{
+  awake_nodes++;
+}
+
+void Scheduler::set_next_activity_time(int node_id, double next_activity_time)
+{
+  if (node_id >= (int)next_activity_time_by_node.size()) {
+    next_activity_time_by_node.resize(node_id + 1, -1);
+  }
+  double previous_time = next_activity_time_by_node[node_id];
+  if (previous_time == next_activity_time) {
+    return;
+  }
+  if (previous_time >= 0) {
+    next_activities.erase(std::make_pair(previous_time, node_id));
+  }
+  next_activity_time_by_node[node_id] = next_activity_time;
+  next_activities.insert(std::make_pair(next_activity_time, node_id));
+}
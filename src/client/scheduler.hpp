@@ -0,0 +1,47 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <set>
+#include <vector>
+
+/*
+* This is the simulation-wide component that knows when the network is quiescent, ie:
+* - there are no messages in flight (sent but still not received by their destination)
+* - every node is sleeping, so no node is in the middle of handling messages or validating blocks/txs
+* When that happens nothing can change until the earliest next activity (next tx from the CTG or next
+* block from any miner), so nodes can sleep straight to that point instead of polling their mailboxes.
+* Used when running with --skip-time-when-possible
+*/
+class Scheduler
+{
+public:
+  explicit Scheduler(unsigned int nodes_count);
+  // Every message put in a mailbox must be registered here
+  void message_sent();
+  // Every message taken from a mailbox must be registered here
+  void message_received();
+  // To be called by node_id right before going to sleep, with its next activity time and for how long
+  // it would sleep if the network weren't quiescent. Returns how long it should actually sleep
+  double get_sleep_duration(int node_id, double next_activity_time, double sleep_duration);
+  // To be called by a node right after waking up from a sleep computed with get_sleep_duration()
+  void node_woke_up();
+  // Messages sent that still weren't received by their destination
+  long get_messages_in_flight() const
+  {
+    return messages_in_flight;
+  }
+
+private:
+  // Messages sent that still weren't received by their destination
+  long messages_in_flight = 0;
+  // Nodes that are not sleeping, so they may still send messages before going to sleep
+  unsigned int awake_nodes;
+  // Next activity time registered by each node, indexed by node id
+  std::vector<double> next_activity_time_by_node;
+  // Same information as next_activity_time_by_node but ordered by time, so we can get the earliest one
+  std::set<std::pair<double, int>> next_activities;
+
+  void set_next_activity_time(int node_id, double next_activity_time);
+};
+
+#endif /* SCHEDULER_HPP */
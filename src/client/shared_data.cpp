@@ -1,25 +1,32 @@
 #include "shared_data.hpp"
 
-// This is the shared (among all nodes and miner) map of blocks we know about
-// It's indexed by the block id
-std::map<long, Block> known_blocks = {{0, Block()}};
+// This is the shared (among all nodes and miner) store of blocks we know about, starting with the genesis block.
+// Every block is stored once here and nodes only keep handles to it
+BlockStore known_blocks;
 
 // In this map we'll store the number of nodes knowing about each block.
 // This is specially usefull for debugging purpuses to log when a block has
 // reached the global consensus of the network.
-std::map<long, int> nodes_knowing_block = {};
+std::map<object_id_t, unsigned int> nodes_knowing_block = {};
 
+// Profiling counter of the calls to Mailbox::by_name() made by nodes
+unsigned long mailbox_lookups = 0;
 
-// <PERFORMANCE_IMPROVEMENTS>
-int perf_improv_stage = PERF_STAGE_INIT;
+// Profiling counters of the iterations of the loop of all nodes and the messages they handled
+unsigned long loop_iterations = 0;
+unsigned long messages_handled = 0;
 
-double next_time_for_global_activity = 0;
+// Number of reorganizations refused because they went through pruned blocks
+unsigned long refused_reorgs = 0;
+// Number of requests of blocks that had been pruned
+unsigned long pruned_blocks_requested = 0;
+// Number of nodes left on a chain that forks below the pruned blocks, counted when they're destroyed
+unsigned long stuck_nodes = 0;
 
-int sent_messages = 0;
+// Memory taken by the rolling bloom filters of known txs of all nodes
+size_t known_txs_filters_memory = 0;
 
-int received_messages = 0;
-
-int next_times_set = 0;
-
-std::set<long> long_sleep_completed_for_node_id = {};
-// </PERFORMANCE_IMPROVEMENTS>
+// Profiling counters of the answers from the rolling bloom filters of known txs, compared with the exact sets
+unsigned long known_txs_lookups = 0;
+unsigned long known_txs_false_positives = 0;
+unsigned long known_txs_false_negatives = 0;
@@ -2,33 +2,42 @@
 #define SHARED_DATA_HPP
 
 #include "../message.hpp"
-
-#define PERF_STAGE_INIT 0
-#define PERF_STAGE_MESSAGES_OK 1
-#define PERF_STAGE_NEXT_ACTIVITY_OK 2
-
+#include "block_store.hpp"
 
 // Here we define the set of structures that will be shared among nodes and miners, given
 // that there's not reason to waste memory duplicating the knwon objects.
 // In each node/miner we just need to have the set of "locally" knows txs and blocks but
 // the corresponding object will then be retrieved from this shared source
 
-// Map of block-id => block that have been broadcasted
-extern std::map<long, Block> known_blocks;
+// Every block that has been broadcasted, by id
+extern BlockStore known_blocks;
 
 // Number of nodes knowing about individual broadcasted blocks
-extern std::map<long, int> nodes_knowing_block;
-
-extern int perf_improv_stage;
-
-extern double next_time_for_global_activity;
-
-extern int sent_messages;
-
-extern int received_messages;
-
-extern int next_times_set;
-
-extern std::set<long> long_sleep_completed_for_node_id;
+extern std::map<object_id_t, unsigned int> nodes_knowing_block;
+
+// Number of mailboxes looked up by name by all nodes. Nodes resolve their mailboxes at startup, so this
+// shouldn't grow while the simulation runs
+extern unsigned long mailbox_lookups;
+
+// Number of iterations of the loop of all nodes, and number of messages they handled
+extern unsigned long loop_iterations;
+extern unsigned long messages_handled;
+
+// With --prune-depth, number of times nodes refused to switch to a better chain that forked below the pruned blocks
+extern unsigned long refused_reorgs;
+// With --prune-depth, number of times nodes were requested a pruned block, which they answer with a MESSAGE_NOTFOUND
+extern unsigned long pruned_blocks_requested;
+// With --prune-depth, number of nodes that ended the simulation on a chain that forks from the highest one below the
+// pruned blocks, so they could never switch to it
+extern unsigned long stuck_nodes;
+
+// With --rolling-bloom-filter, memory taken by the filters of all nodes, in bytes
+extern size_t known_txs_filters_memory;
+
+// With --rolling-bloom-filter and --debug, number of times nodes checked if they knew a tx, and number of times
+// the answer was different from the one we would get without the filter
+extern unsigned long known_txs_lookups;
+extern unsigned long known_txs_false_positives;
+extern unsigned long known_txs_false_negatives;
 
 #endif /* SHARED_DATA_HPP */
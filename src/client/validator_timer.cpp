@@ -1,24 +1,24 @@
 #include "validator_timer.hpp"
 
-double ValidatorTimer::get_flops_to_process_block(Block block)
+double ValidatorTimer::get_flops_to_process_block(const Block & block)
 {
   double flops_to_process_block = 0;
-  for (auto const& transaction : block.get_transactions()) {
-    flops_to_process_block += get_flops_to_process_transaction(transaction);
+  for (auto const& tx_id : block.get_transactions()) {
+    flops_to_process_block += get_flops_to_process_transaction(tx_id);
   }
   return flops_to_process_block;
 }
 
-double ValidatorTimer::get_flops_to_process_transactions(std::map<long, Transaction> txs_to_validate)
+double ValidatorTimer::get_flops_to_process_transactions(const std::vector<object_id_t> & txs_to_validate)
 {
   double flops_to_process_transactions = 0;
-  for (auto const& idAndTransaction : txs_to_validate) {
-    flops_to_process_transactions += get_flops_to_process_transaction(idAndTransaction.second);
+  for (auto const& tx_id : txs_to_validate) {
+    flops_to_process_transactions += get_flops_to_process_transaction(tx_id);
   }
   return flops_to_process_transactions;
 }
 
-double ValidatorTimer::get_flops_to_process_transaction(Transaction tx)
+double ValidatorTimer::get_flops_to_process_transaction(object_id_t tx_id)
 {
   // Coefficients for f(x) = c2*x^2 + c1*x + c0
   // where:
@@ -27,7 +27,7 @@ double ValidatorTimer::get_flops_to_process_transaction(Transaction tx)
   double c2 = 0.0012956;
   double c1 = -0.32167;
   double c0 = 562.97;
-  long x = tx.get_size();
+  long x = txs_table.get_size(tx_id);
   double microseconds = c2 * x * x + c1 * x + c0;
   // A standard host can compute 1Gf per second, which is 1e9 flops.
   // So, considering the standard computing power, a microsecond is the time 1e3 flops
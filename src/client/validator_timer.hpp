@@ -12,11 +12,11 @@
 class ValidatorTimer
 {
 public:
-  double get_flops_to_process_block(Block block);
-  double get_flops_to_process_transactions(std::map<long, Transaction> txs_to_validate);
+  double get_flops_to_process_block(const Block & block);
+  double get_flops_to_process_transactions(const std::vector<object_id_t> & txs_to_validate);
 
 private:
-  double get_flops_to_process_transaction(Transaction tx);
+  double get_flops_to_process_transaction(object_id_t tx_id);
 };
 
 #endif /* VALIDATOR_TIMER_HPP */
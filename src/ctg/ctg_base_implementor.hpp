@@ -8,6 +8,8 @@ class CTG_BaseImplementor
 {
 public:
   virtual TraceItem get_next_activity_item(Node *node) = 0;
+  // CTG deletes its implementor through a pointer to this class
+  virtual ~CTG_BaseImplementor() = default;
 };
 
 #endif /* CTG_BASE_IMPLEMENTOR_HPP */
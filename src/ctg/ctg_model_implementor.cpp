@@ -14,13 +14,17 @@ CTG_ModelImplementor::CTG_ModelImplementor(json ctg_data)
   } else {
     compute_uniform_distribution(ctg_data);
   }
+  for (int i = 0; i < (int)nodes.size(); i++) {
+    random_by_node.push_back(RandomStream(SEED, RANDOM_STREAM_CTG, i));
+  }
 }
 
 TraceItem CTG_ModelImplementor::get_next_activity_item(Node *node)
 {
-  double next_activity_time = calc_next_activity_time(node->get_next_activity_time(), event_probability[node->get_id()], 24 * 60 * 60, txs_per_day);
-  long size = lrand(AVERAGE_BYTES_PER_TX * 2);// On average txs size will be AVERAGE_BYTES_PER_TX bytes
-  long fee_per_byte = lrand(AVERAGE_FEE_PER_BYTE * 2);// On average txs size will be AVERAGE_FEE_PER_BYTE bytes
+  RandomStream & random = random_by_node[node->get_id()];
+  double next_activity_time = calc_next_activity_time(random, node->get_next_activity_time(), event_probability[node->get_id()], 24 * 60 * 60, txs_per_day);
+  long size = random.lrand(AVERAGE_BYTES_PER_TX * 2);// On average txs size will be AVERAGE_BYTES_PER_TX bytes
+  long fee_per_byte = random.lrand(AVERAGE_FEE_PER_BYTE * 2);// On average txs size will be AVERAGE_FEE_PER_BYTE bytes
   TraceItem trace_item = {
     received: next_activity_time,
     confirmed: next_activity_time,
@@ -45,15 +49,15 @@ void CTG_ModelImplementor::compute_exponential_distribution(json ctg_data)
       ++p[node_id];
     }
   }
-  for (int i = 0; i < nodes.size(); ++i) {
+  for (int i = 0; i < (int)nodes.size(); ++i) {
     event_probability.push_back(p[i] / nrolls);
     LOG("event probability for node %d is %f", i, event_probability[i]);
   }
 }
 
-void CTG_ModelImplementor::compute_uniform_distribution(json ctg_data)
+void CTG_ModelImplementor::compute_uniform_distribution(json /*ctg_data*/)
 {
-  for (int i = 0; i < nodes.size(); i++) {
+  for (int i = 0; i < (int)nodes.size(); i++) {
     event_probability.push_back(1.0 / nodes.size());
   }
   LOG("event probability is uniform and is %f for every node", 1.0 / nodes.size());
@@ -15,6 +15,8 @@ private:
   std::vector<int> nodes;
   int txs_per_day;
   std::vector<double> event_probability;
+  // Random streams for the txs of each node, so the ones a node gets don't depend on when the others create theirs
+  std::vector<RandomStream> random_by_node;
   void compute_exponential_distribution(json ctg_data);
   void compute_uniform_distribution(json ctg_data);
 };
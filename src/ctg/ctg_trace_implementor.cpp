@@ -7,7 +7,7 @@ CTG_TraceImplementor::CTG_TraceImplementor(json ctg_data)
   trace = ctg_data["trace"].get<std::vector<TraceItem>>();
 }
 
-TraceItem CTG_TraceImplementor::get_next_activity_item(Node *node)
+TraceItem CTG_TraceImplementor::get_next_activity_item(Node * /*node*/)
 {
   if (current_trace_index < trace.size()) {
     return trace[current_trace_index++];
@@ -16,7 +16,9 @@ TraceItem CTG_TraceImplementor::get_next_activity_item(Node *node)
     TraceItem trace_item = {
       received: (double) SIMULATION_DURATION,
       confirmed: (double) SIMULATION_DURATION,
-      hash: ""
+      hash: "",
+      size: 0,
+      fee_per_byte: 0
     };
     return trace_item;
   }
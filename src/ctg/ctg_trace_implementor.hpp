@@ -12,7 +12,7 @@ public:
   TraceItem get_next_activity_item(Node *node);
 
 private:
-  int current_trace_index = 0;
+  size_t current_trace_index = 0;
   std::vector<TraceItem> trace;
 };
 
@@ -1,6 +1,5 @@
 #ifndef MAGIC_CONSTANTS
 #define MAGIC_CONSTANTS
-#include <random>
 
 // This it the total time in seconds we are going to allow the simulation to run. Initialized from bitcoin_simgrid.cpp
 extern unsigned int SIMULATION_DURATION;
@@ -32,6 +31,14 @@ static const unsigned int BASE_MSG_SIZE = 80;
 // Limit the maximum block size to 1MB, following the limit from the reference client
 static const unsigned int MAX_BLOCK_SIZE = 1048576;
 
+// False positive rate of the rolling bloom filters kept by nodes, the same as the filter of recently confirmed txs of
+// the reference client
+static const double ROLLING_BLOOM_FILTER_FP_RATE = 0.000001;
+
+// With --max-mempool or --mempool-expiry, at least how many of the txs they evicted most recently nodes remember, so
+// they don't request them again. The same as the size of the filter of recently rejected txs of the reference client
+static const unsigned int RECENTLY_EVICTED_TXS_FILTER_SIZE = 120000;
+
 // JSON encoded number are more limited than C++ ones and can't represent legitimate high values.
 // So the tool accepts lower JSON encoded hashrate values that can then be up-scaled using this constant
 extern unsigned int HASHRATE_SCALE;
@@ -40,13 +47,48 @@ extern unsigned int HASHRATE_SCALE;
 // until the next global activity in the network
 extern bool SKIP_TIME_WHEN_POSSIBLE;
 
+// If true, instead of polling their mailboxes every SLEEP_DURATION, nodes will block until a message arrives
+// from any of their peers or until their next activity time comes up, whichever happens first
+extern bool EVENT_DRIVEN;
+
+// If true, every node receives the messages from all its peers in a single mailbox instead of having one
+// mailbox per peer, and messages carry the id of the node that sent them
+extern bool SINGLE_INBOX;
+
+// Maximum number of messages a node takes from each one of its peers in every iteration of its loop, before
+// sending its own messages. With --single-inbox the limit is this number times the number of peers
+extern unsigned int MAX_MESSAGES_PER_PEER;
+
+// If true, all the messages a node sends to a peer in an iteration of its loop go together in a single comm
+extern bool COALESCE_MESSAGES;
+
+// Maximum size in bytes of the mempool of every node. When exceeded, the txs with the lowest fee per byte are evicted. 0 means no limit
+extern long MAX_MEMPOOL_SIZE;
+
+// Txs that have been in the network for longer than this (in seconds) are evicted from the mempools. 0 means they never expire
+extern double MEMPOOL_EXPIRY;
+
+// If greater than 0, instead of remembering every tx they have known about, nodes remember the txs in their
+// mempool plus at least these many of the last txs they learnt about, in a rolling bloom filter
+extern unsigned int ROLLING_BLOOM_FILTER_SIZE;
+
+// Maximum number of blocks whose parent they don't know yet that every node keeps. When exceeded, the one that has
+// been waiting the longest is evicted
+extern unsigned int MAX_ORPHAN_BLOCKS;
+
+// If true, when a node receives a block whose parent it doesn't know, it requests all the blocks it's missing from
+// that chain in a single GetBlocks message, instead of requesting the parent and then its parent and so on
+extern bool GET_BLOCKS;
+
+// If greater than 0, blocks these many blocks below the highest one lose their txs, and nodes refuse reorganizations
+// that would need to go through them. 0 means blocks keep their txs for the whole simulation
+extern unsigned int PRUNE_DEPTH;
+
 // If true, more information about transactions and blocks will be included in the produced log
 extern bool ENABLE_DEBUG;
 
-// Allow to set random generator seed in order to reproduce simulations in a deterministic way
+// Allow to set random generator seed in order to reproduce simulations in a deterministic way. Every node draws
+// random numbers from its own streams derived from it (see RandomStream)
 extern unsigned int SEED;
 
-// Random number generator, will be initialized using SEED value
-extern std::default_random_engine re;
-
 #endif /* MAGIC_CONSTANTS */
@@ -3,7 +3,11 @@
 
 #include "magic_constants.hpp"
 #include "aux_functions.hpp"
+#include "transactions_table.hpp"
+#include "message_pool.hpp"
 #include <set>
+#include <memory>
+#include <algorithm>
 
 typedef enum
 {
@@ -12,28 +16,20 @@ typedef enum
   MESSAGE_TXS,
   MESSAGE_INV,
   MESSAGE_GETDATA,
+  MESSAGE_GETBLOCKS,
+  MESSAGE_NOTFOUND,
+  MESSAGE_ENVELOPE,
 } e_message_type;
 
-typedef enum
-{
-  INV_TX,
-  INV_BLOCK
-} e_inv_type;
-
 class Message
 {
 public:
-  Message(long size) : size(size)
-  {
-    id = lrand();
-  }
+  // Only txs and blocks have an id. Every other message keeps the default one
+  Message(long size) : size(size), id(0) {}
 
-  Message(): size(0)
-  {
-    id = lrand();
-  }
+  Message(): size(0), id(0) {}
 
-  long get_id() const
+  object_id_t get_id() const
   {
     return id;
   }
@@ -43,53 +39,46 @@ public:
     return size;
   }
 
-  virtual e_message_type get_type() const = 0;
-
-  ~Message() = default;
-protected:
-  long size;
-private:
-  long id;
-};
-
-class Transaction : public Message
-{
-public:
-  Transaction() : Message(-1) {}
-
-  Transaction(long size, long fee_per_byte, double confirmed) : Message(size), fee_per_byte(fee_per_byte), confirmed(confirmed) { };
-
-  e_message_type get_type() const
+  // The node that sent this message. Only set when running with --single-inbox, where the receiver can't
+  // tell it from the mailbox it got the message from
+  int get_sender_id() const
   {
-    return MESSAGE_TX;
+    return sender_id;
   }
 
-  long get_fee_per_byte() const
+  void set_sender_id(int id)
   {
-    return fee_per_byte;
+    sender_id = id;
   }
 
-  double get_confirmed() const
-  {
-    return confirmed;
-  }
+  virtual e_message_type get_type() const = 0;
+
+  // Received messages are deleted through a Message pointer, so the destructor needs to be virtual for the
+  // members of each message type to be released, and for the memory to go back to the pool of its type
+  virtual ~Message() = default;
+protected:
+  long size;
+  int sender_id = -1;
+
+  // Used by txs and blocks, which get their id from next_object_id(), and by messages that
+  // just carry an object created elsewhere, so they share its id
+  Message(object_id_t id, long size) : size(size), id(id) {}
 private:
-  long fee_per_byte;
-  double confirmed;
+  object_id_t id;
 };
 
 class Block : public Message
 {
 public:
-  Block() : Message(-1), accumulated_difficulty(0) {}
+  // This is the genesis block, the only one with id 0
+  Block() : Message(0, -1), height(0), parent_id(0), accumulated_difficulty(0), time(0), miner_id(0) {}
 
-  Block(int height, double time, long parent_id, unsigned long long network_difficulty, unsigned long long accumulated_difficulty, std::vector<Transaction> txs, int miner_id = 0)
-  : Message(), height(height), time(time), parent_id(parent_id), network_difficulty(network_difficulty), accumulated_difficulty(accumulated_difficulty), transactions(txs), miner_id(miner_id)
+  // txs are the ids of the transactions included in this block, their data lives in txs_table
+  Block(int height, double time, object_id_t parent_id, unsigned long long network_difficulty, unsigned long long accumulated_difficulty, std::vector<object_id_t> txs, int miner_id = 0)
+  : Message(next_object_id(), txs_table.get_size(txs)), height(height), parent_id(parent_id), transactions(std::move(txs)), network_difficulty(network_difficulty), accumulated_difficulty(accumulated_difficulty), time(time), miner_id(miner_id)
   {
-    for (auto tx : txs) {
-      size += tx.get_size();
-      transactions_map.insert(std::make_pair(tx.get_id(), tx));
-    }
+    // Keep the ids sorted so they can be used in the set operations from aux_functions.hpp
+    std::sort(transactions.begin(), transactions.end());
   };
 
   e_message_type get_type() const
@@ -102,7 +91,7 @@ public:
     return height;
   }
 
-  long get_parent_id() const
+  object_id_t get_parent_id() const
   {
     return parent_id;
   }
@@ -112,16 +101,12 @@ public:
     return miner_id;
   }
 
-  std::vector<Transaction> get_transactions() const
+  // Returns the sorted ids of the txs included in this block
+  const std::vector<object_id_t> & get_transactions() const
   {
     return transactions;
   }
 
-  std::map<long, Transaction> get_transactions_map() const
-  {
-    return transactions_map;
-  }
-
   unsigned long long get_network_difficulty() const
   {
     return network_difficulty;
@@ -136,69 +121,234 @@ public:
   {
     return time;
   }
+
+  // Whether this is a copy of a block without its txs (see get_pruned_copy())
+  bool is_pruned() const
+  {
+    return pruned;
+  }
+
+  // Returns a copy of this block without its txs, with the same id, size and the rest of its data. It's what we keep of
+  // the blocks deep enough in the chain that we only need them to walk the chain and to recalculate the difficulty
+  std::shared_ptr<const Block> get_pruned_copy() const
+  {
+    return std::shared_ptr<const Block>(new Block(*this, true));
+  }
 private:
   int height;
-  long parent_id;
-  std::vector<Transaction> transactions;
-  std::map<long, Transaction> transactions_map;
+  object_id_t parent_id;
+  std::vector<object_id_t> transactions;
   unsigned long long network_difficulty;
   unsigned long long accumulated_difficulty;
   double time;
   int miner_id;
+  bool pruned = false;
+
+  Block(const Block & block, bool pruned)
+  : Message(block.get_id(), block.get_size()), height(block.height), parent_id(block.parent_id), network_difficulty(block.network_difficulty), accumulated_difficulty(block.accumulated_difficulty), time(block.time), miner_id(block.miner_id), pruned(pruned) {}
+};
+
+// Blocks are immutable once created by a miner, so every node and message can share the same instance
+typedef std::shared_ptr<const Block> BlockPtr;
+
+// This is what we send to a peer when relaying a block: just a handle to the shared block
+class BlockMessage : public Message
+{
+public:
+  POOLED_MESSAGE(BlockMessage)
+
+  BlockMessage(const BlockPtr & block) : Message(block->get_id(), block->get_size()), block(block) { };
+
+  e_message_type get_type() const
+  {
+    return MESSAGE_BLOCK;
+  }
+
+  BlockPtr get_block() const
+  {
+    return block;
+  }
+private:
+  BlockPtr block;
 };
 
 class Transactions : public Message
 {
 public:
-  Transactions(std::map<long, Transaction> txs) : Message(), transactions_map(txs) { };
+  POOLED_MESSAGE(Transactions)
+
+  // txs are the sorted ids of the transactions we're relaying, their data lives in txs_table
+  Transactions(std::vector<object_id_t> txs) : Message(), transactions(std::move(txs)) { };
 
   e_message_type get_type() const
   {
     return MESSAGE_TXS;
   }
 
-  std::map<long, Transaction> get_transactions_map() const
+  const std::vector<object_id_t> & get_transactions() const
   {
-    return transactions_map;
+    return transactions;
   }
 private:
-  std::map<long, Transaction> transactions_map;
+  std::vector<object_id_t> transactions;
 };
 
 class Inv : public Message
 {
 public:
-  Inv(std::map<long, e_inv_type> objects) : Message(BASE_MSG_SIZE), objects(objects) { };
+  POOLED_MESSAGE(Inv)
+
+  // blocks_ids and txs_ids are the sorted ids of the objects we're letting the peer know about
+  Inv(std::vector<object_id_t> blocks_ids, std::vector<object_id_t> txs_ids)
+  : Message(BASE_MSG_SIZE), blocks_ids(std::move(blocks_ids)), txs_ids(std::move(txs_ids)) { };
 
   e_message_type get_type() const
   {
     return MESSAGE_INV;
   }
 
-  std::map<long, e_inv_type> get_objects()
+  const std::vector<object_id_t> & get_blocks_ids() const
   {
-    return objects;
+    return blocks_ids;
+  }
+
+  const std::vector<object_id_t> & get_txs_ids() const
+  {
+    return txs_ids;
   }
 private:
-  std::map<long, e_inv_type> objects;
+  std::vector<object_id_t> blocks_ids;
+  std::vector<object_id_t> txs_ids;
 };
 
 class GetData : public Message
 {
 public:
-  GetData(std::set<long> objects) : Message(BASE_MSG_SIZE), objects(objects) { };
+  POOLED_MESSAGE(GetData)
+
+  // objects are the sorted ids of the blocks and txs we're requesting
+  GetData(std::vector<object_id_t> objects) : Message(BASE_MSG_SIZE), objects(std::move(objects)) { };
 
   e_message_type get_type() const
   {
     return MESSAGE_GETDATA;
   }
 
-  std::set<long> get_objects()
+  const std::vector<object_id_t> & get_objects() const
   {
     return objects;
   }
 private:
-  std::set<long> objects;
+  std::vector<object_id_t> objects;
+};
+
+// Used with --get-blocks to request at once all the blocks from the chain of stop_id that I'm missing. locator has
+// ids of blocks from my best chain, from the tip back to the genesis block, more and more spaced. The peer will send
+// me the blocks after the most recent one in the locator that is an ancestor of stop_id, up to stop_id
+class GetBlocks : public Message
+{
+public:
+  POOLED_MESSAGE(GetBlocks)
+
+  GetBlocks(std::vector<object_id_t> locator, object_id_t stop_id)
+  : Message(BASE_MSG_SIZE), locator(std::move(locator)), stop_id(stop_id) { };
+
+  e_message_type get_type() const
+  {
+    return MESSAGE_GETBLOCKS;
+  }
+
+  const std::vector<object_id_t> & get_locator() const
+  {
+    return locator;
+  }
+
+  object_id_t get_stop_id() const
+  {
+    return stop_id;
+  }
+private:
+  std::vector<object_id_t> locator;
+  object_id_t stop_id;
+};
+
+// Lets a peer know that I don't have the objects it requested, so it can request them from someone else
+class NotFound : public Message
+{
+public:
+  POOLED_MESSAGE(NotFound)
+
+  // objects are the sorted ids of the blocks and txs I couldn't send
+  NotFound(std::vector<object_id_t> objects) : Message(BASE_MSG_SIZE), objects(std::move(objects)) { };
+
+  e_message_type get_type() const
+  {
+    return MESSAGE_NOTFOUND;
+  }
+
+  const std::vector<object_id_t> & get_objects() const
+  {
+    return objects;
+  }
+private:
+  std::vector<object_id_t> objects;
+};
+
+// Used with --coalesce-messages to send in a single comm all the messages for a peer from a round. It owns them
+class Envelope : public Message
+{
+public:
+  POOLED_MESSAGE(Envelope)
+
+  Envelope(std::vector<Message*> messages) : Message(get_total_size(messages)), messages(std::move(messages))
+  {
+    get_enclosed_count() += this->messages.size();
+  }
+
+  ~Envelope()
+  {
+    get_enclosed_count() -= messages.size();
+    for (auto const& message : messages) {
+      delete message;
+    }
+  }
+
+  e_message_type get_type() const
+  {
+    return MESSAGE_ENVELOPE;
+  }
+
+  // Returns the messages in the order they were sent. The caller becomes responsible for deleting them
+  std::vector<Message*> release_messages()
+  {
+    get_enclosed_count() -= messages.size();
+    std::vector<Message*> result;
+    result.swap(messages);
+    return result;
+  }
+
+  // Number of messages inside envelopes that weren't opened or deleted yet
+  static unsigned long get_enclosed_outstanding()
+  {
+    return get_enclosed_count();
+  }
+private:
+  std::vector<Message*> messages;
+
+  static unsigned long & get_enclosed_count()
+  {
+    static unsigned long enclosed_count = 0;
+    return enclosed_count;
+  }
+
+  static long get_total_size(const std::vector<Message*> & messages)
+  {
+    long total_size = 0;
+    for (auto const& message : messages) {
+      total_size += message->get_size();
+    }
+    return total_size;
+  }
 };
 
 #endif /* MESSAGE_HPP */
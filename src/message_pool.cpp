@@ -0,0 +1,65 @@
+#include "message_pool.hpp"
+#include "aux_functions.hpp"
+
+XBT_LOG_EXTERNAL_DEFAULT_CATEGORY(bitcoin_simgrid);
+
+MessagePool::MessagePool(const char* name, size_t object_size) : name(name)
+{
+  // Keep every message in the chunks aligned as if it had been allocated on its own
+  size_t alignment = alignof(std::max_align_t);
+  this->object_size = ((object_size + alignment - 1) / alignment) * alignment;
+  get_pools().push_back(this);
+}
+
+void* MessagePool::allocate(size_t size)
+{
+  xbt_assert(size <= object_size, "Message of %zu bytes doesn't fit in the %s pool", size, name);
+  if (free_objects.empty()) {
+    chunks.emplace_back(new char[object_size * OBJECTS_PER_CHUNK]);
+    char* chunk = chunks.back().get();
+    // Add them in reverse order so they're handed out in memory order
+    for (size_t i = OBJECTS_PER_CHUNK; i > 0; i--) {
+      free_objects.push_back(chunk + (i - 1) * object_size);
+    }
+  }
+  void* object = free_objects.back();
+  free_objects.pop_back();
+  outstanding++;
+  return object;
+}
+
+void MessagePool::release(void* object)
+{
+  if (object == nullptr) {
+    return;
+  }
+  free_objects.push_back(object);
+  outstanding--;
+}
+
+void MessagePool::report()
+{
+  for (auto const& pool : get_pools()) {
+    LOG(
+      "%s pool: %lu messages outstanding, %zu KiB allocated",
+      pool->get_name(),
+      pool->get_outstanding(),
+      pool->chunks.size() * pool->object_size * OBJECTS_PER_CHUNK / 1024
+    );
+  }
+}
+
+unsigned long MessagePool::get_total_outstanding()
+{
+  unsigned long total = 0;
+  for (auto const& pool : get_pools()) {
+    total += pool->get_outstanding();
+  }
+  return total;
+}
+
+std::vector<MessagePool*> & MessagePool::get_pools()
+{
+  static std::vector<MessagePool*> pools;
+  return pools;
+}
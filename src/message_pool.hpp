@@ -0,0 +1,63 @@
+#ifndef MESSAGE_POOL_HPP
+#define MESSAGE_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+* Slab allocator for the messages of one type. Memory is taken from the system in chunks of
+* OBJECTS_PER_CHUNK messages and never given back: released messages go to a free list from where
+* the next ones are allocated. It keeps count of the messages allocated and not released yet so we
+* can check at shutdown that none was leaked.
+* Nodes run one at a time (SimGrid actors are not run in parallel by default), so it's not thread safe.
+*/
+class MessagePool
+{
+public:
+  MessagePool(const char* name, size_t object_size);
+  void* allocate(size_t size);
+  void release(void* object);
+  // Number of messages allocated and not released yet
+  unsigned long get_outstanding() const
+  {
+    return outstanding;
+  }
+  const char* get_name() const
+  {
+    return name;
+  }
+  // Logs, for every pool, how many messages are still allocated
+  static void report();
+  // Total number of messages still allocated among all pools
+  static unsigned long get_total_outstanding();
+private:
+  static const size_t OBJECTS_PER_CHUNK = 256;
+  const char* name;
+  size_t object_size;
+  unsigned long outstanding = 0;
+  std::vector<void*> free_objects;
+  std::vector<std::unique_ptr<char[]>> chunks;
+
+  static std::vector<MessagePool*> & get_pools();
+};
+
+// Makes a message class allocate its instances from a MessagePool of its own. Messages must be deleted
+// through a pointer to their own class or to Message, whose destructor is virtual.
+// The pool is never destroyed, given that SimGrid may delete messages left in mailboxes after main() returns
+#define POOLED_MESSAGE(ClassName)                                               \
+  static MessagePool & get_pool()                                               \
+  {                                                                             \
+    static MessagePool* pool = new MessagePool(#ClassName, sizeof(ClassName));  \
+    return *pool;                                                               \
+  }                                                                             \
+  static void* operator new(size_t size)                                        \
+  {                                                                             \
+    return get_pool().allocate(size);                                           \
+  }                                                                             \
+  static void operator delete(void* object)                                     \
+  {                                                                             \
+    get_pool().release(object);                                                 \
+  }
+
+#endif /* MESSAGE_POOL_HPP */
@@ -0,0 +1,43 @@
+#include "random_stream.hpp"
+
+// Finalizer of SplitMix64: turns numbers that differ in a few bits (like consecutive ones) into unrelated ones
+static inline uint64_t mix(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Odd constant SplitMix64 adds for each number, (2**64) / golden ratio
+static const uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+RandomStream::RandomStream(unsigned int seed, e_random_stream_component component, int node_id)
+{
+  // Mixing after adding each part keeps streams with close keys (eg: consecutive node ids) unrelated
+  key = mix(mix(mix(seed + GOLDEN_GAMMA) + component) + (uint32_t)node_id);
+}
+
+uint64_t RandomStream::next()
+{
+  return mix(key + GOLDEN_GAMMA * ++counter);
+}
+
+long RandomStream::lrand(long limit)
+{
+  // Keep as many bits as fit in a non-negative long
+  long result = (long)(next() >> (65 - sizeof(long) * 8));
+  return limit ? result % limit : result;
+}
+
+unsigned long long RandomStream::llrand(unsigned long long limit)
+{
+  unsigned long long result = next();
+  return limit ? result % limit : result;
+}
+
+double RandomStream::frand(double limit)
+{
+  // The highest 53 bits fill the mantissa of a double in [0, 1)
+  double result = (next() >> 11) * (1.0 / (1ULL << 53));
+  return limit ? result * limit : result;
+}
@@ -0,0 +1,34 @@
+#ifndef RANDOM_STREAM_HPP
+#define RANDOM_STREAM_HPP
+
+#include <cstdint>
+
+// The parts of the simulation that draw random numbers. Each one has its own stream for every node
+typedef enum {
+  RANDOM_STREAM_CTG,
+  RANDOM_STREAM_MINER,
+} e_random_stream_component;
+
+/*
+* Counter-based random number generator, modeled after SplitMix64. A stream is keyed by the seed, the component that
+* draws from it and the node it draws for, and the n-th number it returns only depends on that key and n. As every
+* actor draws only from its own streams, the numbers it gets don't depend on the order in which SimGrid runs the
+* actors, nor on what the others draw, so a given seed reproduces the same simulation.
+*/
+class RandomStream
+{
+public:
+  RandomStream(unsigned int seed, e_random_stream_component component, int node_id);
+  // Returns a uniformly distributed number in [0, 2**64)
+  uint64_t next();
+  // Returns a uniformly distributed non-negative number lower than limit, or any non-negative number if limit is 0
+  long lrand(long limit = 0);
+  unsigned long long llrand(unsigned long long limit = 0);
+  // Returns a uniformly distributed number in [0, limit), or in [0, 1) if limit is 0
+  double frand(double limit = 0);
+private:
+  uint64_t key;
+  uint64_t counter = 0;
+};
+
+#endif /* RANDOM_STREAM_HPP */
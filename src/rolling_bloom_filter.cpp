@@ -0,0 +1,86 @@
+#include "rolling_bloom_filter.hpp"
+#include <algorithm>
+#include <cmath>
+
+RollingBloomFilter::RollingBloomFilter(unsigned int max_elements, double fp_rate, uint32_t tweak) : tweak(tweak)
+{
+  xbt_assert(max_elements > 0, "A rolling bloom filter needs room for at least one element");
+  xbt_assert(fp_rate > 0 && fp_rate < 1, "The false positive rate of a rolling bloom filter must be between 0 and 1");
+  double log_fp_rate = std::log(fp_rate);
+  // The optimal number of hash functions is log(fp_rate) / log(0.5), limited to 50 to keep insert() and contains() cheap
+  hash_functions = std::max(1, std::min((int)std::round(log_fp_rate / std::log(0.5)), 50));
+  // There are 3 generations, and the oldest one gets wiped when the current one is full, so with half of
+  // max_elements per generation we always have at least the last max_elements ids
+  entries_per_generation = (max_elements + 1) / 2;
+  unsigned int filter_max_elements = entries_per_generation * 3;
+  // For n elements, k hash functions and a false positive rate p we need -k * n / log(1 - p^(1/k)) bits
+  unsigned long filter_bits = std::ceil(-1.0 * hash_functions * filter_max_elements / std::log(1.0 - std::exp(log_fp_rate / hash_functions)));
+  // Each position takes 2 bits, one in each word of a pair
+  data.resize(((filter_bits + 63) / 64) << 1);
+  reset();
+}
+
+void RollingBloomFilter::insert(object_id_t id)
+{
+  if (entries_this_generation == entries_per_generation) {
+    entries_this_generation = 0;
+    generation++;
+    if (generation == 4) {
+      generation = 1;
+    }
+    // Wipe the positions tagged with the generation we're about to reuse, whose bits are the same as the new tag
+    uint64_t generation_mask1 = 0 - (uint64_t)(generation & 1);
+    uint64_t generation_mask2 = 0 - (uint64_t)(generation >> 1);
+    for (size_t p = 0; p < data.size(); p += 2) {
+      uint64_t p1 = data[p];
+      uint64_t p2 = data[p + 1];
+      uint64_t mask = (p1 ^ generation_mask1) | (p2 ^ generation_mask2);
+      data[p] = p1 & mask;
+      data[p + 1] = p2 & mask;
+    }
+  }
+  entries_this_generation++;
+  for (unsigned int n = 0; n < hash_functions; n++) {
+    uint32_t h = hash(n, id);
+    int bit = h & 0x3F;
+    // Map h to an even position of data without a modulo, see https://lemire.me/blog/2016/06/27/a-fast-alternative-to-the-modulo-reduction/
+    size_t pos = ((uint64_t)h * (uint64_t)data.size()) >> 32;
+    pos &= ~(size_t)1;
+    data[pos] &= ~((uint64_t)1 << bit);
+    data[pos] |= (uint64_t)(generation & 1) << bit;
+    data[pos + 1] &= ~((uint64_t)1 << bit);
+    data[pos + 1] |= (uint64_t)(generation >> 1) << bit;
+  }
+}
+
+bool RollingBloomFilter::contains(object_id_t id) const
+{
+  for (unsigned int n = 0; n < hash_functions; n++) {
+    uint32_t h = hash(n, id);
+    int bit = h & 0x3F;
+    size_t pos = ((uint64_t)h * (uint64_t)data.size()) >> 32;
+    pos &= ~(size_t)1;
+    // A position belongs to some generation if either of its bits is set
+    if (!(((data[pos] | data[pos + 1]) >> bit) & 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void RollingBloomFilter::reset()
+{
+  entries_this_generation = 0;
+  generation = 1;
+  std::fill(data.begin(), data.end(), 0);
+}
+
+uint32_t RollingBloomFilter::hash(unsigned int hash_number, object_id_t id) const
+{
+  // Ids are consecutive numbers, so they need to be mixed well. This is the finalizer of SplitMix64
+  uint64_t x = ((uint64_t)(hash_number * 0xFBA4C795 + tweak) << 32) | id;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  x = x ^ (x >> 31);
+  return (uint32_t)x;
+}
@@ -0,0 +1,44 @@
+#ifndef ROLLING_BLOOM_FILTER_HPP
+#define ROLLING_BLOOM_FILTER_HPP
+
+#include "aux_functions.hpp"
+#include <cstdint>
+#include <vector>
+
+/*
+* Probabilistic set of the most recently inserted ids, modeled after Bitcoin Core's CRollingBloomFilter.
+* It remembers at least the last max_elements ids inserted (and up to one and a half times as many) and answers
+* contains() for other ids with a false positive rate of about fp_rate. Its memory doesn't depend on how many ids
+* have been inserted nor on how high they are.
+* Entries are tagged with one of 3 generations, using 2 bits per position of the filter. When a generation fills
+* up, the entries of the oldest one are wiped and its tag reused. Ids can't be removed one by one.
+*/
+class RollingBloomFilter
+{
+public:
+  // tweak changes the hash functions, so different filters make different false positives
+  RollingBloomFilter(unsigned int max_elements, double fp_rate, uint32_t tweak);
+  void insert(object_id_t id);
+  bool contains(object_id_t id) const;
+  // Forgets every id inserted so far
+  void reset();
+
+  // Returns the memory used by the filter, in bytes
+  size_t get_memory_size() const
+  {
+    return data.size() * sizeof(uint64_t);
+  }
+private:
+  unsigned int entries_per_generation;
+  unsigned int entries_this_generation = 0;
+  // Current generation tag: 1, 2 or 3 (0 means empty)
+  unsigned int generation = 1;
+  unsigned int hash_functions;
+  uint32_t tweak;
+  // Pairs of words: the bits of a position in the first word and in the second one make the tag of its generation
+  std::vector<uint64_t> data;
+
+  uint32_t hash(unsigned int hash_number, object_id_t id) const;
+};
+
+#endif /* ROLLING_BLOOM_FILTER_HPP */
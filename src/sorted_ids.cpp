@@ -0,0 +1,367 @@
+#include "sorted_ids.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SORTED_IDS_X86
+#include <immintrin.h>
+#endif
+
+typedef size_t (*sorted_ids_kernel)(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out);
+
+namespace {
+
+size_t intersect_scalar(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  while (i < left_size && j < right_size) {
+    if (left[i] < right[j]) {
+      i++;
+    } else if (right[j] < left[i]) {
+      j++;
+    } else {
+      out[k++] = left[i];
+      i++;
+      j++;
+    }
+  }
+  return k;
+}
+
+size_t diff_scalar(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  while (i < left_size && j < right_size) {
+    if (left[i] < right[j]) {
+      out[k++] = left[i++];
+    } else if (right[j] < left[i]) {
+      j++;
+    } else {
+      i++;
+      j++;
+    }
+  }
+  std::copy(left + i, left + left_size, out + k);
+  return k + (left_size - i);
+}
+
+// There is no vector version of the union: every implementation uses this merge, which has no data dependent branches
+size_t union_scalar(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  while (i < left_size && j < right_size) {
+    uint32_t l = left[i];
+    uint32_t r = right[j];
+    out[k++] = l < r ? l : r;
+    i += l <= r;
+    j += r <= l;
+  }
+  std::copy(left + i, left + left_size, out + k);
+  k += left_size - i;
+  std::copy(right + j, right + right_size, out + k);
+  return k + (right_size - j);
+}
+
+#ifdef SORTED_IDS_X86
+/*
+* The vector kernels compare a block of left ids against a block of right ids at once, comparing the left block with
+* every rotation of the right one. Then they advance the block with the lowest maximum (or both if they are equal) and
+* finish with the scalar kernels once one of the arrays has less than a full block left.
+* To write only some lanes of a block we pack them at the beginning with a shuffle from these tables, indexed by the
+* mask of the lanes to keep.
+*/
+struct ShuffleTables
+{
+  uint8_t sse[16][16];
+  uint32_t avx[256][8];
+
+  ShuffleTables()
+  {
+    for (int mask = 0; mask < 16; mask++) {
+      int k = 0;
+      for (int lane = 0; lane < 4; lane++) {
+        if (mask & (1 << lane)) {
+          for (int byte = 0; byte < 4; byte++) {
+            sse[mask][k * 4 + byte] = lane * 4 + byte;
+          }
+          k++;
+        }
+      }
+      for (; k < 4; k++) {
+        for (int byte = 0; byte < 4; byte++) {
+          sse[mask][k * 4 + byte] = 0x80;
+        }
+      }
+    }
+    for (int mask = 0; mask < 256; mask++) {
+      int k = 0;
+      for (int lane = 0; lane < 8; lane++) {
+        if (mask & (1 << lane)) {
+          avx[mask][k++] = lane;
+        }
+      }
+      for (; k < 8; k++) {
+        avx[mask][k] = 0;
+      }
+    }
+  }
+};
+
+const ShuffleTables shuffle_tables;
+
+__attribute__((target("sse4.2")))
+int sse42_matches(__m128i l, __m128i r)
+{
+  __m128i eq0 = _mm_cmpeq_epi32(l, r);
+  __m128i eq1 = _mm_cmpeq_epi32(l, _mm_shuffle_epi32(r, _MM_SHUFFLE(0, 3, 2, 1)));
+  __m128i eq2 = _mm_cmpeq_epi32(l, _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2)));
+  __m128i eq3 = _mm_cmpeq_epi32(l, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 1, 0, 3)));
+  __m128i eq = _mm_or_si128(_mm_or_si128(eq0, eq1), _mm_or_si128(eq2, eq3));
+  return _mm_movemask_ps(_mm_castsi128_ps(eq));
+}
+
+__attribute__((target("sse4.2")))
+__m128i sse42_pack(__m128i l, int mask)
+{
+  return _mm_shuffle_epi8(l, _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle_tables.sse[mask])));
+}
+
+// capacity is the room left in out, which can be less than min(left_size, right_size) when called for the tail of the AVX2 kernel
+__attribute__((target("sse4.2")))
+size_t intersect_sse42_with_capacity(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out, size_t capacity)
+{
+  size_t i = 0, j = 0, k = 0;
+  while (i + 4 <= left_size && j + 4 <= right_size) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + j));
+    int mask = sse42_matches(l, r);
+    if (mask) {
+      int matches = __builtin_popcount(mask);
+      __m128i packed = sse42_pack(l, mask);
+      if (k + 4 <= capacity) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), packed);
+      } else {
+        // Near the end of out, where a full store wouldn't fit
+        uint32_t tmp[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(tmp), packed);
+        std::copy(tmp, tmp + matches, out + k);
+      }
+      k += matches;
+    }
+    uint32_t left_max = left[i + 3];
+    uint32_t right_max = right[j + 3];
+    i += left_max <= right_max ? 4 : 0;
+    j += right_max <= left_max ? 4 : 0;
+  }
+  return k + intersect_scalar(left + i, left_size - i, right + j, right_size - j, out + k);
+}
+
+__attribute__((target("sse4.2")))
+size_t intersect_sse42(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  return intersect_sse42_with_capacity(left, left_size, right, right_size, out, std::min(left_size, right_size));
+}
+
+__attribute__((target("sse4.2")))
+size_t diff_sse42(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  // Lanes of the current left block found in any of the right blocks compared with it so far
+  int found = 0;
+  while (i + 4 <= left_size && j + 4 <= right_size) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + j));
+    found |= sse42_matches(l, r);
+    uint32_t left_max = left[i + 3];
+    uint32_t right_max = right[j + 3];
+    if (left_max <= right_max) {
+      // We never write more ids than we have read from left, so a full store always fits in out
+      int keep = ~found & 0xF;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), sse42_pack(l, keep));
+      k += __builtin_popcount(keep);
+      found = 0;
+      i += 4;
+    }
+    if (right_max <= left_max) {
+      j += 4;
+    }
+  }
+  if (found) {
+    // The current left block was partially matched by previous right blocks, finish it against the rest of right
+    for (int lane = 0; lane < 4; lane++, i++) {
+      if (!(found & (1 << lane)) && !std::binary_search(right + j, right + right_size, left[i])) {
+        out[k++] = left[i];
+      }
+    }
+  }
+  return k + diff_scalar(left + i, left_size - i, right + j, right_size - j, out + k);
+}
+
+__attribute__((target("avx2")))
+int avx2_matches(__m256i l, __m256i r)
+{
+  __m256i eq = _mm256_cmpeq_epi32(l, r);
+  for (int rotation = 1; rotation < 8; rotation++) {
+    __m256i indexes = _mm256_setr_epi32(
+      rotation & 7, (rotation + 1) & 7, (rotation + 2) & 7, (rotation + 3) & 7,
+      (rotation + 4) & 7, (rotation + 5) & 7, (rotation + 6) & 7, (rotation + 7) & 7
+    );
+    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(l, _mm256_permutevar8x32_epi32(r, indexes)));
+  }
+  return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+}
+
+__attribute__((target("avx2")))
+__m256i avx2_pack(__m256i l, int mask)
+{
+  return _mm256_permutevar8x32_epi32(l, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(shuffle_tables.avx[mask])));
+}
+
+__attribute__((target("avx2")))
+size_t intersect_avx2(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  size_t capacity = std::min(left_size, right_size);
+  while (i + 8 <= left_size && j + 8 <= right_size) {
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+    __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + j));
+    int mask = avx2_matches(l, r);
+    if (mask) {
+      int matches = __builtin_popcount(mask);
+      __m256i packed = avx2_pack(l, mask);
+      if (k + 8 <= capacity) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), packed);
+      } else {
+        uint32_t tmp[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(tmp), packed);
+        std::copy(tmp, tmp + matches, out + k);
+      }
+      k += matches;
+    }
+    uint32_t left_max = left[i + 7];
+    uint32_t right_max = right[j + 7];
+    i += left_max <= right_max ? 8 : 0;
+    j += right_max <= left_max ? 8 : 0;
+  }
+  return k + intersect_sse42_with_capacity(left + i, left_size - i, right + j, right_size - j, out + k, capacity - k);
+}
+
+__attribute__((target("avx2")))
+size_t diff_avx2(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  int found = 0;
+  while (i + 8 <= left_size && j + 8 <= right_size) {
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+    __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + j));
+    found |= avx2_matches(l, r);
+    uint32_t left_max = left[i + 7];
+    uint32_t right_max = right[j + 7];
+    if (left_max <= right_max) {
+      int keep = ~found & 0xFF;
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), avx2_pack(l, keep));
+      k += __builtin_popcount(keep);
+      found = 0;
+      i += 8;
+    }
+    if (right_max <= left_max) {
+      j += 8;
+    }
+  }
+  if (found) {
+    for (int lane = 0; lane < 8; lane++, i++) {
+      if (!(found & (1 << lane)) && !std::binary_search(right + j, right + right_size, left[i])) {
+        out[k++] = left[i];
+      }
+    }
+  }
+  return k + diff_sse42(left + i, left_size - i, right + j, right_size - j, out + k);
+}
+#endif
+
+struct SortedIdsKernels
+{
+  e_sorted_ids_impl impl;
+  sorted_ids_kernel intersect;
+  sorted_ids_kernel diff;
+};
+
+bool is_supported(e_sorted_ids_impl impl)
+{
+  switch (impl) {
+#ifdef SORTED_IDS_X86
+    case SORTED_IDS_AVX2:
+      return __builtin_cpu_supports("avx2");
+    case SORTED_IDS_SSE42:
+      return __builtin_cpu_supports("sse4.2");
+#endif
+    case SORTED_IDS_SCALAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+SortedIdsKernels get_kernels(e_sorted_ids_impl impl)
+{
+  switch (impl) {
+#ifdef SORTED_IDS_X86
+    case SORTED_IDS_AVX2:
+      return {SORTED_IDS_AVX2, intersect_avx2, diff_avx2};
+    case SORTED_IDS_SSE42:
+      return {SORTED_IDS_SSE42, intersect_sse42, diff_sse42};
+#endif
+    default:
+      return {SORTED_IDS_SCALAR, intersect_scalar, diff_scalar};
+  }
+}
+
+SortedIdsKernels & kernels()
+{
+  static SortedIdsKernels best = get_kernels(
+    is_supported(SORTED_IDS_AVX2) ? SORTED_IDS_AVX2 : is_supported(SORTED_IDS_SSE42) ? SORTED_IDS_SSE42 : SORTED_IDS_SCALAR
+  );
+  return best;
+}
+
+}
+
+size_t intersect_sorted_ids(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  return kernels().intersect(left, left_size, right, right_size, out);
+}
+
+size_t diff_sorted_ids(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  return kernels().diff(left, left_size, right, right_size, out);
+}
+
+size_t union_sorted_ids(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out)
+{
+  return union_scalar(left, left_size, right, right_size, out);
+}
+
+bool use_sorted_ids_impl(e_sorted_ids_impl impl)
+{
+  if (!is_supported(impl)) {
+    return false;
+  }
+  kernels() = get_kernels(impl);
+  return true;
+}
+
+e_sorted_ids_impl get_sorted_ids_impl()
+{
+  return kernels().impl;
+}
+
+const char* get_sorted_ids_impl_name(e_sorted_ids_impl impl)
+{
+  switch (impl) {
+    case SORTED_IDS_AVX2:
+      return "avx2";
+    case SORTED_IDS_SSE42:
+      return "sse4.2";
+    default:
+      return "scalar";
+  }
+}
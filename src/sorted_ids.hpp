@@ -0,0 +1,27 @@
+#ifndef SORTED_IDS_HPP
+#define SORTED_IDS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+* Set operations over sorted arrays of 32 bit ids without duplicates. Each one writes its result, which is
+* sorted too, in out and returns how many ids it wrote. out can't overlap the inputs and must have room for:
+*   intersect_sorted_ids: min(left_size, right_size) ids
+*   diff_sorted_ids: left_size ids
+*   union_sorted_ids: left_size + right_size ids
+* The implementation is picked the first time one of them is called, according to what the CPU supports:
+* AVX2, SSE4.2 or a plain scalar merge.
+*/
+size_t intersect_sorted_ids(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out);
+size_t diff_sorted_ids(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out);
+size_t union_sorted_ids(const uint32_t *left, size_t left_size, const uint32_t *right, size_t right_size, uint32_t *out);
+
+enum e_sorted_ids_impl { SORTED_IDS_SCALAR, SORTED_IDS_SSE42, SORTED_IDS_AVX2 };
+
+// Forces a given implementation (mostly for benchmarking). Returns false, and changes nothing, if the CPU doesn't support it
+bool use_sorted_ids_impl(e_sorted_ids_impl impl);
+e_sorted_ids_impl get_sorted_ids_impl();
+const char* get_sorted_ids_impl_name(e_sorted_ids_impl impl);
+
+#endif /* SORTED_IDS_HPP */
@@ -0,0 +1,206 @@
+/*
+* Checks BlockStore: every block can be found by id and in its height bucket, and the lookups that use the skip
+* pointers (get_ancestor and get_last_common_ancestor) give the same as walking the parents one by one. The
+* hand-picked cases cover the genesis block alone, a block against its own ancestors, and forks starting right at
+* the genesis block, then random trees with forks of different lengths. With --prune-depth, exactly the blocks deep
+* enough must lose their txs, including late ones on forks below the pruned height, and the lookups must still work.
+*/
+#include "test_helpers.hpp"
+#include "../client/block_store.hpp"
+#include <map>
+
+// Every block added, as it was before the store pruned it
+static std::map<object_id_t, BlockPtr> originals;
+
+// Adds a block on top of the given one, with a few txs so block ids have gaps like in a simulation
+static object_id_t add_block(BlockStore & store, std::vector<object_id_t> & blocks, object_id_t parent_id)
+{
+  std::vector<object_id_t> txs;
+  for (unsigned int i = random_below(3); i > 0; i--) {
+    txs.push_back(txs_table.create(100, 1, 0, 0));
+  }
+  BlockPtr block = std::make_shared<Block>(store.get(parent_id)->get_height() + 1, blocks.size(), parent_id, 1ULL, 1ULL, txs);
+  store.insert(block);
+  originals[block->get_id()] = block;
+  blocks.push_back(block->get_id());
+  return block->get_id();
+}
+
+static object_id_t naive_ancestor(const BlockStore & store, object_id_t block_id, int height)
+{
+  while (store.get(block_id)->get_height() > height) {
+    block_id = store.get(block_id)->get_parent_id();
+  }
+  return block_id;
+}
+
+static object_id_t naive_last_common_ancestor(const BlockStore & store, object_id_t a, object_id_t b)
+{
+  int height = std::min(store.get(a)->get_height(), store.get(b)->get_height());
+  a = naive_ancestor(store, a, height);
+  b = naive_ancestor(store, b, height);
+  while (a != b) {
+    a = store.get(a)->get_parent_id();
+    b = store.get(b)->get_parent_id();
+  }
+  return a;
+}
+
+static void check_lookups(const BlockStore & store, object_id_t block_id, object_id_t other_id)
+{
+  for (int height = 0; height <= store.get(block_id)->get_height(); height++) {
+    xbt_assert(
+      store.get_ancestor(block_id, height) == naive_ancestor(store, block_id, height),
+      "Wrong ancestor of %u at height %d",
+      block_id,
+      height
+    );
+  }
+  object_id_t expected = naive_last_common_ancestor(store, block_id, other_id);
+  xbt_assert(store.get_last_common_ancestor(block_id, other_id) == expected, "Wrong last common ancestor of %u and %u", block_id, other_id);
+  xbt_assert(store.get_last_common_ancestor(other_id, block_id) == expected, "Wrong last common ancestor of %u and %u", other_id, block_id);
+}
+
+static void check_contents(const BlockStore & store, const std::vector<object_id_t> & blocks)
+{
+  xbt_assert(store.size() == blocks.size(), "The store has %zu blocks instead of %zu", store.size(), blocks.size());
+  size_t blocks_by_height = 0;
+  for (int height = 0; height < store.get_heights_count(); height++) {
+    for (size_t i = 0; i < store.get_blocks_count_at_height(height); i++) {
+      xbt_assert(store.get_block_at_height(height, i)->get_height() == height, "Block in the wrong height bucket");
+      blocks_by_height++;
+    }
+  }
+  xbt_assert(blocks_by_height == store.size(), "The height buckets have %zu blocks instead of %zu", blocks_by_height, store.size());
+  xbt_assert(PRUNE_DEPTH > 0 || store.get_pruned_count() == 0, "Nothing should be pruned without --prune-depth");
+  for (auto const& block_id : blocks) {
+    xbt_assert(store.contains(block_id) && store.get(block_id)->get_id() == block_id, "Block %u is missing", block_id);
+    for (auto const& tx_id : store.get(block_id)->get_transactions()) {
+      xbt_assert(!store.contains(tx_id), "Tx %u is taken for a block", tx_id);
+    }
+  }
+}
+
+static void check_edge_cases()
+{
+  BlockStore store;
+  std::vector<object_id_t> blocks = {0};
+  check_contents(store, blocks);
+  check_lookups(store, 0, 0);
+
+  // A single chain, where every block is the last common ancestor of itself and the blocks above it
+  object_id_t tip = 0;
+  for (int i = 0; i < 300; i++) {
+    tip = add_block(store, blocks, tip);
+  }
+  for (auto const& block_id : blocks) {
+    check_lookups(store, tip, block_id);
+    xbt_assert(store.get_last_common_ancestor(block_id, block_id) == block_id, "%u should be its own last common ancestor", block_id);
+  }
+  // Inserting a block again changes nothing
+  store.insert(store.get(tip));
+  check_contents(store, blocks);
+
+  // Forks of several lengths from the genesis block, so the only common ancestor is at height 0
+  for (int fork_length : {1, 2, 63, 64, 65, 500}) {
+    object_id_t fork_tip = 0;
+    for (int i = 0; i < fork_length; i++) {
+      fork_tip = add_block(store, blocks, fork_tip);
+    }
+    check_lookups(store, fork_tip, tip);
+    xbt_assert(store.get_last_common_ancestor(fork_tip, tip) == 0, "Forks from the genesis block should only share it");
+  }
+  check_contents(store, blocks);
+}
+
+// Builds a random tree: mostly extending one of the last blocks, like competing miners do, and from time to time
+// a fork from anywhere
+static void check_random_trees()
+{
+  for (int tree_number = 0; tree_number < 5; tree_number++) {
+    BlockStore store;
+    std::vector<object_id_t> blocks = {0};
+    for (int i = 0; i < 3000; i++) {
+      size_t back = (random_below(20) == 0) ? random_below(blocks.size()) : random_below(std::min<size_t>(blocks.size(), 3));
+      add_block(store, blocks, blocks[blocks.size() - 1 - back]);
+    }
+    check_contents(store, blocks);
+    for (int i = 0; i < 1000; i++) {
+      check_lookups(store, blocks[random_below(blocks.size())], blocks[random_below(blocks.size())]);
+    }
+  }
+}
+
+// Checks that the blocks above the genesis one up to the given height, and only them, are pruned copies
+static void check_pruned(const BlockStore & store, const std::vector<object_id_t> & blocks, int pruned_height)
+{
+  xbt_assert(store.get_pruned_height() == pruned_height, "Pruned up to height %d instead of %d", store.get_pruned_height(), pruned_height);
+  size_t pruned_count = 0;
+  for (auto const& block_id : blocks) {
+    if (block_id == 0) {
+      continue;
+    }
+    const BlockPtr & stored = store.get(block_id);
+    const BlockPtr & original = originals[block_id];
+    bool should_be_pruned = original->get_height() <= pruned_height;
+    xbt_assert(stored->is_pruned() == should_be_pruned, "Block %u at height %d pruned: %d", block_id, original->get_height(), stored->is_pruned());
+    xbt_assert(should_be_pruned ? stored->get_transactions().empty() : stored == original, "Block %u lost its txs", block_id);
+    xbt_assert(
+      stored->get_height() == original->get_height() && stored->get_parent_id() == original->get_parent_id() && stored->get_size() == original->get_size(),
+      "The pruned copy of %u lost header data",
+      block_id
+    );
+    xbt_assert(!original->is_pruned(), "The original block %u got pruned", block_id);
+    pruned_count += should_be_pruned;
+  }
+  xbt_assert(store.get_pruned_count() == pruned_count, "Counted %zu pruned blocks instead of %zu", store.get_pruned_count(), pruned_count);
+}
+
+static void check_pruning()
+{
+  PRUNE_DEPTH = 3;
+  BlockStore store;
+  std::vector<object_id_t> blocks = {0};
+  // Nothing is pruned until the highest block is more than PRUNE_DEPTH blocks above the first one
+  object_id_t tip = 0;
+  for (int i = 0; i < 3; i++) {
+    tip = add_block(store, blocks, tip);
+    check_pruned(store, blocks, 0);
+  }
+  tip = add_block(store, blocks, tip);
+  check_pruned(store, blocks, 1);
+  // A late fork from the genesis block: its first block is already at the pruned height, the next one isn't
+  object_id_t fork_tip = add_block(store, blocks, 0);
+  check_pruned(store, blocks, 1);
+  fork_tip = add_block(store, blocks, fork_tip);
+  check_pruned(store, blocks, 1);
+  // Pruning goes up one height per new highest block, and lookups still work on the pruned blocks
+  for (int i = 0; i < 10; i++) {
+    tip = add_block(store, blocks, tip);
+    check_pruned(store, blocks, store.get_heights_count() - 1 - (int)PRUNE_DEPTH);
+  }
+  check_lookups(store, tip, fork_tip);
+  check_contents(store, blocks);
+
+  // Pruning everything below the highest blocks
+  PRUNE_DEPTH = 1;
+  BlockStore random_store;
+  blocks = {0};
+  for (int i = 0; i < 1000; i++) {
+    size_t back = (random_below(10) == 0) ? random_below(blocks.size()) : random_below(std::min<size_t>(blocks.size(), 3));
+    add_block(random_store, blocks, blocks[blocks.size() - 1 - back]);
+  }
+  check_pruned(random_store, blocks, random_store.get_heights_count() - 2);
+  for (int i = 0; i < 500; i++) {
+    check_lookups(random_store, blocks[random_below(blocks.size())], blocks[random_below(blocks.size())]);
+  }
+  PRUNE_DEPTH = 0;
+}
+
+int main()
+{
+  check_edge_cases();
+  check_random_trees();
+  check_pruning();
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+* The set operations over sorted vectors of aux_functions.hpp: hand-picked cases where merging in place is easy to
+* get wrong (empty sides, one side entirely before or after the other, equal sets, a std::set as the source), then
+* random sets checked against the std algorithms, for ids and for a key type that takes the generic versions.
+*/
+#include "test_helpers.hpp"
+#include <algorithm>
+#include <iterator>
+
+template<typename KeyType, typename Container>
+void check_operations(const std::vector<KeyType> & left, const Container & right)
+{
+  std::vector<KeyType> expected_union, expected_intersection, expected_difference;
+  std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(expected_union));
+  std::set_intersection(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(expected_intersection));
+  std::set_difference(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(expected_difference));
+
+  std::vector<KeyType> target = left;
+  MergeInto(target, right);
+  xbt_assert(target == expected_union, "Wrong MergeInto of %zu and %zu elements", left.size(), right.size());
+  target = left;
+  EraseAllOf(target, right);
+  xbt_assert(target == expected_difference, "Wrong EraseAllOf of %zu and %zu elements", left.size(), right.size());
+  target = left;
+  RetainOnly(target, right);
+  xbt_assert(target == expected_intersection, "Wrong RetainOnly of %zu and %zu elements", left.size(), right.size());
+
+  // The result parameter starts with leftovers, which have to be discarded
+  std::vector<KeyType> result(3, 7);
+  IntersectInto(result, left, right);
+  xbt_assert(result == expected_intersection, "Wrong IntersectInto of %zu and %zu elements", left.size(), right.size());
+  result.assign(3, 7);
+  DiffInto(result, left, right);
+  xbt_assert(result == expected_difference, "Wrong DiffInto of %zu and %zu elements", left.size(), right.size());
+}
+
+template<typename KeyType>
+void check_both_containers(const std::vector<KeyType> & left, const std::vector<KeyType> & right)
+{
+  check_operations(left, right);
+  check_operations(left, std::set<KeyType>(right.begin(), right.end()));
+  check_operations(right, left);
+}
+
+static void check_edge_cases()
+{
+  const std::vector<object_id_t> empty;
+  const std::vector<object_id_t> low = {1, 2, 3};
+  const std::vector<object_id_t> high = {10, 20, 30};
+  const std::vector<object_id_t> interleaved = {2, 10, 15, 30, 40};
+  check_both_containers(empty, empty);
+  check_both_containers(low, empty);
+  check_both_containers(low, low);
+  check_both_containers(low, high);
+  check_both_containers(low, interleaved);
+  check_both_containers(high, interleaved);
+  // A single element at either end of the other set
+  check_both_containers(high, {0});
+  check_both_containers(high, {UINT32_MAX});
+  check_both_containers(high, {30});
+
+  std::vector<object_id_t> target;
+  EraseSorted(target, 5u);
+  xbt_assert(target.empty(), "EraseSorted on an empty vector");
+  for (object_id_t id : {5u, 9u, 1u, 5u, 7u, 9u}) {
+    InsertSorted(target, id);
+  }
+  xbt_assert(target == std::vector<object_id_t>({1, 5, 7, 9}), "InsertSorted should keep the vector sorted and without duplicates");
+  EraseSorted(target, 6u);
+  EraseSorted(target, 1u);
+  EraseSorted(target, 9u);
+  xbt_assert(target == std::vector<object_id_t>({5, 7}), "EraseSorted should remove just the given element");
+  xbt_assert(ContainsSorted(target, 5u) && !ContainsSorted(target, 6u) && !ContainsSorted(empty, 6u), "Wrong ContainsSorted");
+}
+
+template<typename KeyType>
+void check_random_sets(object_id_t max_value)
+{
+  for (int i = 0; i < 1000; i++) {
+    std::vector<object_id_t> left = random_sorted_ids(random_below(65), max_value);
+    std::vector<object_id_t> right = random_sorted_ids(random_below(65), max_value);
+    check_both_containers(std::vector<KeyType>(left.begin(), left.end()), std::vector<KeyType>(right.begin(), right.end()));
+  }
+}
+
+int main()
+{
+  check_edge_cases();
+  // Dense values, so the sets overlap a lot, and sparse ones, so they barely do
+  check_random_sets<object_id_t>(100);
+  check_random_sets<object_id_t>(100000);
+  check_random_sets<long>(100);
+  check_random_sets<long>(100000);
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+* IdSet: the edge cases of a bitset that grows on demand (id 0, ids past the end, inserting twice, erasing what
+* isn't there), then random inserts and erases checked against a std::set.
+*/
+#include "test_helpers.hpp"
+
+static void check_edge_cases()
+{
+  IdSet ids;
+  xbt_assert(ids.size() == 0 && !ids.contains(0) && !ids.contains(1000), "A new IdSet should be empty");
+  // Erasing from an empty set, or past its end, does nothing
+  ids.erase(0);
+  ids.erase(1000);
+  xbt_assert(ids.size() == 0, "Erasing ids that aren't there changed the size");
+
+  ids.insert(0);
+  ids.insert(0);
+  xbt_assert(ids.contains(0) && ids.size() == 1, "Inserting an id twice should count it once");
+
+  // Growing to a high id leaves the ones in between out
+  ids.insert(100000);
+  xbt_assert(ids.contains(100000) && ids.size() == 2, "Wrong high id");
+  for (object_id_t id = 1; id < 100000; id++) {
+    xbt_assert(!ids.contains(id), "Id %u wasn't inserted", id);
+  }
+  xbt_assert(!ids.contains(100001), "Ids past the highest one shouldn't be contained");
+
+  ids.erase(100000);
+  ids.erase(100000);
+  xbt_assert(!ids.contains(100000) && ids.size() == 1, "Erasing an id twice should count it once");
+  ids.erase(0);
+  xbt_assert(ids.size() == 0 && !ids.contains(0), "The set should be empty again");
+}
+
+static void check_against_set()
+{
+  IdSet ids;
+  std::set<object_id_t> expected;
+  for (int i = 0; i < 50000; i++) {
+    object_id_t id = random_below(2000);
+    if (random_below(3) == 0) {
+      ids.erase(id);
+      expected.erase(id);
+    } else {
+      ids.insert(id);
+      expected.insert(id);
+    }
+    xbt_assert(ids.size() == expected.size(), "Size is %zu instead of %zu after operation %d", ids.size(), expected.size(), i);
+  }
+  for (object_id_t id = 0; id < 2000; id++) {
+    xbt_assert(ids.contains(id) == (expected.count(id) > 0), "Wrong contains(%u)", id);
+  }
+}
+
+int main()
+{
+  check_edge_cases();
+  check_against_set();
+  return 0;
+}
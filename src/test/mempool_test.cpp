@@ -0,0 +1,231 @@
+/*
+* Checks Mempool against a plain std::set of ids, recomputing from scratch what its indexes should give: the total
+* size, the txs selected for a block, and the ones removed when expiring and trimming. The hand-picked cases cover
+* empty mempools, txs added or removed twice, fee ties, a selection that stops at the first tx that doesn't fit, txs
+* not confirmed yet when reproducing a trace, and the boundaries of expire() and trim_to_size().
+*/
+#include "test_helpers.hpp"
+#include "../client/mempool.hpp"
+
+static void check_contents(const Mempool & mempool, const std::set<object_id_t> & expected)
+{
+  xbt_assert(mempool.get_ids() == std::vector<object_id_t>(expected.begin(), expected.end()), "Wrong ids in the mempool");
+  xbt_assert(mempool.size() == expected.size(), "Mempool has %zu txs instead of %zu", mempool.size(), expected.size());
+  long expected_size = 0;
+  for (auto const& tx_id : expected) {
+    expected_size += txs_table.get_size(tx_id);
+  }
+  xbt_assert(mempool.get_size_in_bytes() == expected_size, "Size is %ld bytes instead of %ld", mempool.get_size_in_bytes(), expected_size);
+}
+
+// Txs by decreasing fee per byte, ties broken by decreasing id, like the index of the mempool
+static std::vector<object_id_t> by_fee_per_byte(const std::set<object_id_t> & txs)
+{
+  std::vector<object_id_t> sorted(txs.begin(), txs.end());
+  std::sort(sorted.begin(), sorted.end(), [](object_id_t a, object_id_t b) {
+    return std::make_pair(txs_table.get_fee_per_byte(a), a) > std::make_pair(txs_table.get_fee_per_byte(b), b);
+  });
+  return sorted;
+}
+
+static std::vector<object_id_t> select_by_fee(const Mempool & mempool, double confirmation_time, long available_size)
+{
+  std::vector<object_id_t> selected;
+  mempool.select_by_fee(selected, confirmation_time, available_size);
+  return selected;
+}
+
+static void check_select_by_fee(const Mempool & mempool, const std::set<object_id_t> & expected, double confirmation_time, long available_size)
+{
+  std::vector<object_id_t> expected_selected;
+  long selected_size = 0;
+  for (auto const& tx_id : by_fee_per_byte(expected)) {
+    if (txs_table.get_confirmed(tx_id) > confirmation_time) {
+      continue;
+    }
+    if (selected_size + txs_table.get_size(tx_id) > available_size) {
+      break;
+    }
+    selected_size += txs_table.get_size(tx_id);
+    expected_selected.push_back(tx_id);
+  }
+  xbt_assert(
+    select_by_fee(mempool, confirmation_time, available_size) == expected_selected,
+    "Wrong txs selected for %ld bytes confirmed at %f",
+    available_size,
+    confirmation_time
+  );
+}
+
+static void check_edge_cases()
+{
+  Mempool mempool;
+  std::set<object_id_t> expected;
+  check_contents(mempool, expected);
+  xbt_assert(select_by_fee(mempool, 0, 1000).empty(), "Selected txs from an empty mempool");
+  mempool.remove({});
+  mempool.add({});
+  check_contents(mempool, expected);
+
+  // size, fee per byte, confirmed, created
+  object_id_t cheap = txs_table.create(100, 1, 10, 0);
+  object_id_t tie_low = txs_table.create(100, 5, 10, 0);
+  object_id_t tie_high = txs_table.create(100, 5, 10, 0);
+  object_id_t big = txs_table.create(1000, 9, 10, 0);
+  object_id_t late = txs_table.create(100, 20, 50, 0);
+  mempool.add({cheap, tie_low, tie_high, big, late});
+  // Adding them again, or removing txs that aren't there, changes nothing
+  mempool.add({tie_low, big});
+  mempool.remove({next_object_id()});
+  expected = {cheap, tie_low, tie_high, big, late};
+  check_contents(mempool, expected);
+
+  // Ties are taken by decreasing id, and nothing is selected when the first tx doesn't fit
+  xbt_assert(select_by_fee(mempool, 100, 1399) == std::vector<object_id_t>({late, big, tie_high, tie_low}), "Wrong selection with fee ties");
+  xbt_assert(select_by_fee(mempool, 100, 99).empty(), "Selected a tx that doesn't fit");
+  // The selection stops at big, which doesn't fit, even if the ones after it would
+  xbt_assert(select_by_fee(mempool, 100, 500) == std::vector<object_id_t>({late}), "Selection didn't stop at the first tx that doesn't fit");
+  // late isn't confirmed yet at 10, and txs confirmed exactly then are eligible
+  xbt_assert(select_by_fee(mempool, 10, 1200) == std::vector<object_id_t>({big, tie_high, tie_low}), "Wrong selection of confirmed txs");
+  xbt_assert(select_by_fee(mempool, 9, 1000000).empty(), "Selected txs not confirmed yet");
+  check_select_by_fee(mempool, expected, 10, 1000000);
+  check_select_by_fee(mempool, expected, 50, 1000000);
+
+  mempool.remove({tie_low, big});
+  mempool.remove({tie_low});
+  expected = {cheap, tie_high, late};
+  check_contents(mempool, expected);
+  xbt_assert(select_by_fee(mempool, 10, 1000) == std::vector<object_id_t>({tie_high, cheap}), "Removed txs were selected");
+  mempool.remove({cheap, tie_high, late});
+  check_contents(mempool, {});
+}
+
+static void check_expire_and_trim()
+{
+  // size, fee per byte, confirmed, created
+  object_id_t old_cheap = txs_table.create(100, 1, 0, 10);
+  object_id_t old_expensive = txs_table.create(200, 8, 0, 10);
+  object_id_t tie_low = txs_table.create(300, 4, 0, 20);
+  object_id_t tie_high = txs_table.create(400, 4, 0, 30);
+  Mempool mempool;
+  std::vector<object_id_t> removed;
+  mempool.expire(100, removed);
+  mempool.trim_to_size(0, removed);
+  xbt_assert(removed.empty(), "Removed txs from an empty mempool");
+
+  mempool.add({old_cheap, old_expensive, tie_low, tie_high});
+  // Only txs created strictly before the given time expire, and removed is appended to
+  removed.push_back(0);
+  mempool.expire(10, removed);
+  xbt_assert(removed == std::vector<object_id_t>({0}), "Expired txs created at the given time");
+  removed.clear();
+  mempool.expire(20, removed);
+  xbt_assert(removed == std::vector<object_id_t>({old_cheap, old_expensive}), "Wrong txs expired");
+  check_contents(mempool, {tie_low, tie_high});
+
+  // Nothing to do if it already fits, the lowest id goes first among fee ties, and it stops as soon as the rest fits
+  mempool.add({old_cheap, old_expensive});
+  removed.clear();
+  mempool.trim_to_size(1000, removed);
+  xbt_assert(removed.empty(), "Trimmed a mempool that fits");
+  mempool.trim_to_size(999, removed);
+  xbt_assert(removed == std::vector<object_id_t>({old_cheap}), "Wrong txs trimmed to 999 bytes");
+  removed.clear();
+  mempool.trim_to_size(600, removed);
+  xbt_assert(removed == std::vector<object_id_t>({tie_low}), "Wrong txs trimmed to 600 bytes");
+  removed.clear();
+  mempool.trim_to_size(599, removed);
+  xbt_assert(removed == std::vector<object_id_t>({tie_high}), "Wrong txs trimmed to 599 bytes");
+  check_contents(mempool, {old_expensive});
+  removed.clear();
+  mempool.trim_to_size(0, removed);
+  xbt_assert(removed == std::vector<object_id_t>({old_expensive}), "Trimming to 0 bytes should empty the mempool");
+  check_contents(mempool, {});
+}
+
+// Returns up to max_size of the given txs, sorted
+static std::vector<object_id_t> random_txs(const std::vector<object_id_t> & all_txs, size_t max_size)
+{
+  std::vector<object_id_t> txs;
+  for (size_t i = random_below(max_size + 1); i > 0; i--) {
+    InsertSorted(txs, all_txs[random_below(all_txs.size())]);
+  }
+  return txs;
+}
+
+static void check_random_operations()
+{
+  std::vector<object_id_t> all_txs;
+  for (int i = 0; i < 2000; i++) {
+    // Few distinct fees, so there are ties
+    all_txs.push_back(txs_table.create(100 + random_below(900), random_below(20), random_below(1000), random_below(1000)));
+    // Leave gaps in the ids, as blocks do
+    if (random_below(4) == 0) {
+      next_object_id();
+    }
+  }
+
+  Mempool mempool;
+  std::set<object_id_t> expected;
+  for (int i = 0; i < 3000; i++) {
+    std::vector<object_id_t> txs = random_txs(all_txs, 30);
+    std::vector<object_id_t> removed;
+    switch (random_below(8)) {
+    case 0:
+      mempool.remove(txs);
+      for (auto const& tx_id : txs) {
+        expected.erase(tx_id);
+      }
+      break;
+    case 1: {
+      double created_before = random_below(200);
+      mempool.expire(created_before, removed);
+      std::vector<object_id_t> expected_removed;
+      for (auto const& tx_id : expected) {
+        if (txs_table.get_created(tx_id) < created_before) {
+          expected_removed.push_back(tx_id);
+        }
+      }
+      xbt_assert(removed == expected_removed, "Wrong txs expired before %f", created_before);
+      for (auto const& tx_id : expected_removed) {
+        expected.erase(tx_id);
+      }
+      break;
+    }
+    case 2: {
+      long max_size = mempool.get_size_in_bytes() * random_below(100) / 100;
+      mempool.trim_to_size(max_size, removed);
+      // The ones with the lowest fee per byte go first, until the rest fits
+      std::vector<object_id_t> candidates = by_fee_per_byte(expected);
+      long remaining_size = mempool.get_size_in_bytes() + txs_table.get_size(removed);
+      std::vector<object_id_t> expected_removed;
+      for (auto it = candidates.rbegin(); it != candidates.rend() && remaining_size > max_size; ++it) {
+        expected_removed.push_back(*it);
+        remaining_size -= txs_table.get_size(*it);
+      }
+      std::sort(expected_removed.begin(), expected_removed.end());
+      xbt_assert(removed == expected_removed, "Wrong txs removed trimming to %ld bytes", max_size);
+      xbt_assert(mempool.get_size_in_bytes() <= max_size, "The mempool still takes %ld bytes after trimming to %ld", mempool.get_size_in_bytes(), max_size);
+      for (auto const& tx_id : expected_removed) {
+        expected.erase(tx_id);
+      }
+      break;
+    }
+    default:
+      mempool.add(txs);
+      expected.insert(txs.begin(), txs.end());
+    }
+    check_contents(mempool, expected);
+    // Every tx confirmed, then only some of them
+    check_select_by_fee(mempool, expected, 1000, random_below(20000));
+    check_select_by_fee(mempool, expected, random_below(1000), random_below(20000));
+  }
+}
+
+int main()
+{
+  check_edge_cases();
+  check_expire_and_trim();
+  check_random_operations();
+  return 0;
+}
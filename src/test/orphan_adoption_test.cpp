@@ -0,0 +1,129 @@
+/*
+* Regression test for the orderings that made nodes crash adopting orphans (get_peer() of their own id): blocks
+* arriving child-first, and an orphan in the middle of a chain being evicted. Node needs a running simulation, so
+* this drives an OrphanPool the way Node::handle_block does: a block is either connected, if its parent is, or
+* kept as an orphan, and only a connected block gets its orphans adopted. Every adopted orphan must then have a
+* connected parent, which is what keeps Node from requesting blocks to itself.
+*/
+#include "test_helpers.hpp"
+#include "../client/orphan_pool.hpp"
+#include <algorithm>
+
+class Chain
+{
+public:
+  explicit Chain(size_t max_orphans) : orphans(max_orphans)
+  {
+    connected.insert(0);
+  }
+
+  void receive(const BlockPtr & block)
+  {
+    if (is_connected(block->get_id())) {
+      return;
+    }
+    if (!is_connected(block->get_parent_id())) {
+      xbt_assert(!adopting, "Adopted orphan %u whose parent %u isn't connected", block->get_id(), block->get_parent_id());
+      orphans.add(block);
+      return;
+    }
+    connected.insert(block->get_id());
+    orphans.take_children(block->get_id(), to_adopt);
+    if (adopting) {
+      return;
+    }
+    adopting = true;
+    while (!to_adopt.empty()) {
+      BlockPtr orphan = std::move(to_adopt.back());
+      to_adopt.pop_back();
+      receive(orphan);
+    }
+    adopting = false;
+  }
+
+  bool is_connected(object_id_t block_id) const
+  {
+    return connected.count(block_id) > 0;
+  }
+
+  size_t orphans_count() const
+  {
+    return orphans.size();
+  }
+private:
+  OrphanPool orphans;
+  std::set<object_id_t> connected;
+  std::vector<BlockPtr> to_adopt;
+  bool adopting = false;
+};
+
+// Blocks on top of the genesis block, from the lowest one
+static std::vector<BlockPtr> make_chain(int length)
+{
+  std::vector<BlockPtr> blocks;
+  object_id_t parent_id = 0;
+  for (int height = 1; height <= length; height++) {
+    blocks.push_back(std::make_shared<Block>(height, height, parent_id, 1ULL, 1ULL, std::vector<object_id_t>()));
+    parent_id = blocks.back()->get_id();
+  }
+  return blocks;
+}
+
+// A <- B <- C with room for a single orphan: C waits for B, then B evicts C while it waits for A
+static void check_evicted_in_the_middle()
+{
+  std::vector<BlockPtr> abc = make_chain(3);
+  Chain chain(1);
+  chain.receive(abc[2]);
+  chain.receive(abc[1]);
+  chain.receive(abc[0]);
+  xbt_assert(chain.is_connected(abc[1]->get_id()), "B should be connected once A arrives");
+  xbt_assert(!chain.is_connected(abc[2]->get_id()), "C was evicted, it can't be connected");
+  chain.receive(abc[2]);
+  xbt_assert(chain.is_connected(abc[2]->get_id()) && chain.orphans_count() == 0, "C should connect when it comes again");
+}
+
+// A long chain received child-first, with enough room for it and without
+static void check_child_first()
+{
+  for (size_t max_orphans : {1, 10, 98, 99, 100}) {
+    std::vector<BlockPtr> blocks = make_chain(100);
+    Chain chain(max_orphans);
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+      chain.receive(*it);
+    }
+    xbt_assert(chain.is_connected(blocks[0]->get_id()), "The first block should be connected");
+    bool all_connected = std::all_of(blocks.begin(), blocks.end(), [&chain](const BlockPtr & block) {
+      return chain.is_connected(block->get_id());
+    });
+    xbt_assert(all_connected == (max_orphans >= blocks.size() - 1), "With room for %zu orphans all connected is %d", max_orphans, all_connected);
+  }
+}
+
+// Any order, including blocks received several times, with a small pool
+static void check_random_orders()
+{
+  for (int i = 0; i < 2000; i++) {
+    std::vector<BlockPtr> blocks = make_chain(1 + random_below(20));
+    std::vector<BlockPtr> arrivals = blocks;
+    arrivals.insert(arrivals.end(), blocks.begin(), blocks.begin() + random_below(blocks.size()));
+    std::shuffle(arrivals.begin(), arrivals.end(), test_random());
+    Chain chain(1 + random_below(4));
+    for (auto const& block : arrivals) {
+      chain.receive(block);
+    }
+    // Sending the whole chain in order connects whatever was evicted
+    for (auto const& block : blocks) {
+      chain.receive(block);
+    }
+    xbt_assert(chain.is_connected(blocks.back()->get_id()) && chain.orphans_count() == 0, "The chain should be connected at the end");
+  }
+}
+
+int main()
+{
+  check_evicted_in_the_middle();
+  check_child_first();
+  check_random_orders();
+  return 0;
+}
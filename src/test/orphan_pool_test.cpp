@@ -0,0 +1,164 @@
+/*
+* Checks OrphanPool against a list of the orphans in arrival order: when it's full, the oldest orphan and every
+* orphan that descends from it must go, and take_children() must give the children of a block in reverse order of
+* arrival and take them out of the pool. The hand-picked cases cover a pool with room for a single orphan, blocks
+* added twice, a chain evicted from its first block or from the middle, and siblings taken while their own children
+* stay.
+*/
+#include "test_helpers.hpp"
+#include "../client/orphan_pool.hpp"
+#include <algorithm>
+#include <list>
+
+static BlockPtr make_orphan(object_id_t parent_id)
+{
+  return std::make_shared<Block>(1, 0, parent_id, 1ULL, 1ULL, std::vector<object_id_t>());
+}
+
+static std::vector<BlockPtr> take_children(OrphanPool & pool, object_id_t parent_id)
+{
+  std::vector<BlockPtr> children;
+  pool.take_children(parent_id, children);
+  return children;
+}
+
+// Removes from expected the oldest orphan and the ones that descend from it
+static void evict_oldest(std::list<BlockPtr> & expected)
+{
+  std::set<object_id_t> evicted = {expected.front()->get_id()};
+  expected.pop_front();
+  bool evicted_more = true;
+  while (evicted_more) {
+    evicted_more = false;
+    for (auto it = expected.begin(); it != expected.end();) {
+      if (evicted.count((*it)->get_parent_id()) > 0) {
+        evicted.insert((*it)->get_id());
+        it = expected.erase(it);
+        evicted_more = true;
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+static void check_contents(const OrphanPool & pool, const std::list<BlockPtr> & expected)
+{
+  xbt_assert(pool.size() == expected.size(), "The pool has %zu orphans instead of %zu", pool.size(), expected.size());
+  for (auto const& block : expected) {
+    xbt_assert(pool.contains(block->get_id()), "Orphan %u is missing", block->get_id());
+  }
+}
+
+static void check_edge_cases()
+{
+  const object_id_t unknown_id = next_object_id();
+
+  // With room for a single orphan, every new one replaces the previous one, and adding it again changes nothing
+  OrphanPool single(1);
+  BlockPtr first = make_orphan(unknown_id);
+  BlockPtr second = make_orphan(unknown_id);
+  xbt_assert(take_children(single, unknown_id).empty(), "Took children from an empty pool");
+  xbt_assert(single.add(first) && !single.add(first), "add() should only accept a block once");
+  xbt_assert(single.add(second) && !single.contains(first->get_id()) && single.size() == 1, "The oldest orphan wasn't evicted");
+  xbt_assert(!single.add(second) && single.contains(second->get_id()), "Adding the only orphan again evicted it");
+  xbt_assert(take_children(single, unknown_id) == std::vector<BlockPtr>({second}), "Wrong children in a pool of one");
+  xbt_assert(single.size() == 0 && single.add(first), "A block taken out can be added again");
+
+  // A chain waiting for its first block: evicting that one takes the whole chain, but not the other orphans
+  OrphanPool pool(5);
+  std::vector<BlockPtr> chain = {make_orphan(unknown_id)};
+  for (int i = 0; i < 3; i++) {
+    chain.push_back(make_orphan(chain.back()->get_id()));
+  }
+  BlockPtr other = make_orphan(next_object_id());
+  for (auto const& block : chain) {
+    pool.add(block);
+  }
+  pool.add(other);
+  BlockPtr newest = make_orphan(unknown_id);
+  pool.add(newest);
+  check_contents(pool, {other, newest});
+  // The chain comes again out of order. When its oldest block, in the middle of it, is evicted, the blocks above
+  // go with it but the one below stays
+  for (int i : {1, 3, 2, 0}) {
+    pool.add(chain[i]);
+  }
+  check_contents(pool, {newest, chain[1], chain[3], chain[2], chain[0]});
+  xbt_assert(!pool.contains(other->get_id()), "The oldest orphan should be evicted");
+  std::list<BlockPtr> newer = {make_orphan(unknown_id), make_orphan(unknown_id)};
+  for (auto const& block : newer) {
+    pool.add(block);
+  }
+  newer.push_front(chain[0]);
+  check_contents(pool, newer);
+
+  // Siblings come in reverse order of arrival, and taking them leaves their children in the pool
+  OrphanPool siblings(10);
+  object_id_t parent_id = next_object_id();
+  std::vector<BlockPtr> children = {make_orphan(parent_id), make_orphan(parent_id), make_orphan(parent_id)};
+  BlockPtr grandchild = make_orphan(children[1]->get_id());
+  siblings.add(children[1]);
+  siblings.add(grandchild);
+  siblings.add(children[0]);
+  siblings.add(children[2]);
+  xbt_assert(
+    take_children(siblings, parent_id) == std::vector<BlockPtr>({children[2], children[0], children[1]}),
+    "Siblings should come from the last one to arrive"
+  );
+  check_contents(siblings, {grandchild});
+  xbt_assert(take_children(siblings, parent_id).empty(), "Children were taken twice");
+  xbt_assert(take_children(siblings, children[1]->get_id()) == std::vector<BlockPtr>({grandchild}), "Wrong grandchild");
+}
+
+static void check_random_operations(size_t max_size)
+{
+  // Blocks whose parents are either one of a few blocks that never arrive or another one of these blocks, so
+  // there are chains and trees of orphans
+  const object_id_t first_unknown_id = 1000000000;
+  std::vector<BlockPtr> blocks;
+  for (int i = 0; i < 300; i++) {
+    object_id_t parent_id = (blocks.empty() || random_below(3) == 0) ? first_unknown_id + random_below(20) : blocks[random_below(blocks.size())]->get_id();
+    blocks.push_back(make_orphan(parent_id));
+  }
+
+  OrphanPool pool(max_size);
+  std::list<BlockPtr> expected;
+  for (int i = 0; i < 20000; i++) {
+    if (random_below(3) != 0) {
+      const BlockPtr & block = blocks[random_below(blocks.size())];
+      bool already_there = std::find(expected.begin(), expected.end(), block) != expected.end();
+      bool added = pool.add(block);
+      xbt_assert(added == !already_there, "add(%u) returned %d", block->get_id(), added);
+      if (added) {
+        if (expected.size() == max_size) {
+          evict_oldest(expected);
+        }
+        expected.push_back(block);
+      }
+    } else {
+      object_id_t parent_id = (random_below(2) == 0) ? first_unknown_id + random_below(20) : blocks[random_below(blocks.size())]->get_id();
+      std::vector<BlockPtr> expected_children;
+      for (auto it = expected.begin(); it != expected.end();) {
+        if ((*it)->get_parent_id() == parent_id) {
+          expected_children.push_back(*it);
+          it = expected.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      std::reverse(expected_children.begin(), expected_children.end());
+      xbt_assert(take_children(pool, parent_id) == expected_children, "Wrong children of %u", parent_id);
+    }
+    check_contents(pool, expected);
+  }
+}
+
+int main()
+{
+  check_edge_cases();
+  for (size_t max_size : {1, 2, 30, 1000}) {
+    check_random_operations(max_size);
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+* Checks PeerMask against a std::vector<bool>: first the slots around the word boundaries (63, 64, 127, 128),
+* set_first() shrinking after a bigger mask and reset() of slots whose word was never allocated, then random
+* operations with slots both in the first word and in the ones allocated for nodes with more than 64 peers.
+*/
+#include "test_helpers.hpp"
+
+static const int MAX_SLOTS = 300;
+
+static void check_mask(const PeerMask & mask, const std::vector<bool> & expected, const char* operation)
+{
+  bool expected_none = true;
+  for (int slot = 0; slot < MAX_SLOTS; slot++) {
+    xbt_assert(mask.test(slot) == expected[slot], "Wrong test(%d) after %s", slot, operation);
+    expected_none = expected_none && !expected[slot];
+  }
+  xbt_assert(mask.none() == expected_none, "Wrong none() after %s", operation);
+}
+
+static void set_first(PeerMask & mask, std::vector<bool> & expected, int count)
+{
+  mask.set_first(count);
+  for (int slot = 0; slot < MAX_SLOTS; slot++) {
+    expected[slot] = (slot < count);
+  }
+}
+
+static void check_edge_cases()
+{
+  PeerMask mask;
+  std::vector<bool> expected(MAX_SLOTS, false);
+  check_mask(mask, expected, "creating the mask");
+  // Slots beyond the allocated words are neither set nor a problem to reset
+  mask.reset(200);
+  check_mask(mask, expected, "resetting a slot never set");
+
+  for (int slot : {63, 64, 127, 128}) {
+    mask.set(slot);
+    expected[slot] = true;
+    check_mask(mask, expected, "setting a slot at a word boundary");
+  }
+  for (int slot : {64, 63, 128, 127}) {
+    mask.reset(slot);
+    expected[slot] = false;
+    check_mask(mask, expected, "resetting a slot at a word boundary");
+  }
+
+  for (int count : {0, 1, 63, 64, 65, 127, 128, 129, MAX_SLOTS}) {
+    set_first(mask, expected, count);
+    check_mask(mask, expected, "set_first()");
+  }
+  // Fewer slots than before: the words already allocated have to be cleared too
+  for (int count : {200, 64, 0}) {
+    set_first(mask, expected, count);
+    check_mask(mask, expected, "set_first() after a bigger one");
+  }
+
+  set_first(mask, expected, MAX_SLOTS);
+  mask.clear();
+  expected.assign(MAX_SLOTS, false);
+  check_mask(mask, expected, "clear()");
+  mask.set(MAX_SLOTS - 1);
+  expected[MAX_SLOTS - 1] = true;
+  check_mask(mask, expected, "setting the last slot after clear()");
+}
+
+static void check_random_operations()
+{
+  PeerMask mask;
+  std::vector<bool> expected(MAX_SLOTS, false);
+  for (int i = 0; i < 100000; i++) {
+    // Mostly slots in the first word, which is the common case
+    int slot = (random_below(4) == 0) ? random_below(MAX_SLOTS) : random_below(64);
+    switch (random_below(20)) {
+    case 0:
+      set_first(mask, expected, random_below(MAX_SLOTS));
+      break;
+    case 1:
+      mask.clear();
+      expected.assign(MAX_SLOTS, false);
+      break;
+    case 2: case 3: case 4: case 5: case 6: case 7: case 8:
+      mask.reset(slot);
+      expected[slot] = false;
+      break;
+    default:
+      mask.set(slot);
+      expected[slot] = true;
+    }
+    check_mask(mask, expected, "a random operation");
+  }
+}
+
+int main()
+{
+  check_edge_cases();
+  check_random_operations();
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+* Checks that a RandomStream only depends on its key: the same (seed, component, node) gives the same numbers
+* however the draws of different streams are interleaved, and changing any part of the key gives other numbers.
+* Also checks the ranges of lrand, llrand and frand, including a limit of 1 and no limit at all, and that their
+* values are spread evenly.
+*/
+#include "test_helpers.hpp"
+#include "../random_stream.hpp"
+#include <cmath>
+
+static void check_same_numbers(RandomStream a, RandomStream b)
+{
+  for (int i = 0; i < 10000; i++) {
+    xbt_assert(a.next() == b.next(), "Streams with the same key gave different numbers at draw %d", i);
+  }
+}
+
+static void check_other_numbers(RandomStream a, RandomStream b)
+{
+  int same = 0;
+  for (int i = 0; i < 10000; i++) {
+    same += (a.next() == b.next());
+  }
+  xbt_assert(same == 0, "Streams with different keys gave %d equal numbers", same);
+}
+
+static void check_keys()
+{
+  check_same_numbers(RandomStream(1, RANDOM_STREAM_MINER, 3), RandomStream(1, RANDOM_STREAM_MINER, 3));
+  check_other_numbers(RandomStream(1, RANDOM_STREAM_MINER, 3), RandomStream(2, RANDOM_STREAM_MINER, 3));
+  check_other_numbers(RandomStream(1, RANDOM_STREAM_MINER, 3), RandomStream(1, RANDOM_STREAM_CTG, 3));
+  check_other_numbers(RandomStream(1, RANDOM_STREAM_MINER, 3), RandomStream(1, RANDOM_STREAM_MINER, 4));
+  // Keys that only differ in the highest bits, or where one part takes the place of another
+  check_other_numbers(RandomStream(0, RANDOM_STREAM_CTG, 0), RandomStream(UINT32_MAX, RANDOM_STREAM_CTG, 0));
+  check_other_numbers(RandomStream(0, RANDOM_STREAM_CTG, 0), RandomStream(0, RANDOM_STREAM_CTG, -1));
+  check_other_numbers(RandomStream(0, RANDOM_STREAM_MINER, 0), RandomStream(0, RANDOM_STREAM_CTG, 1));
+  for (int i = 0; i < 100; i++) {
+    unsigned int seed = test_random()();
+    int node_id = random_below(10000);
+    check_same_numbers(RandomStream(seed, RANDOM_STREAM_CTG, node_id), RandomStream(seed, RANDOM_STREAM_CTG, node_id));
+    check_other_numbers(RandomStream(seed, RANDOM_STREAM_CTG, node_id), RandomStream(seed, RANDOM_STREAM_CTG, node_id + 1));
+  }
+}
+
+// What a stream draws doesn't depend on what the others draw in between
+static void check_interleaved_draws()
+{
+  RandomStream alone(7, RANDOM_STREAM_CTG, 0);
+  std::vector<uint64_t> expected;
+  for (int i = 0; i < 1000; i++) {
+    expected.push_back(alone.next());
+  }
+  std::vector<RandomStream> streams;
+  for (int node_id = 0; node_id < 10; node_id++) {
+    streams.push_back(RandomStream(7, RANDOM_STREAM_CTG, node_id));
+  }
+  for (int i = 0; i < 1000; i++) {
+    for (int node_id = 9; node_id > 0; node_id -= 1 + random_below(3)) {
+      streams[node_id].next();
+    }
+    xbt_assert(streams[0].next() == expected[i], "Draw %d changed when interleaved with other streams", i);
+  }
+}
+
+static void check_evenly_spread(const std::vector<long> & histogram, long draws)
+{
+  double expected = (double) draws / histogram.size();
+  for (size_t i = 0; i < histogram.size(); i++) {
+    xbt_assert(std::fabs(histogram[i] - expected) < expected * 0.05, "Got %ld draws of %zu, expected about %f", histogram[i], i, expected);
+  }
+}
+
+static void check_ranges()
+{
+  RandomStream stream(1, RANDOM_STREAM_CTG, 0);
+  const long draws = 1000000;
+  std::vector<long> lrand_histogram(10), llrand_histogram(7), frand_histogram(16);
+  // Without a limit, the highest bits must be used too
+  bool lrand_high_bit = false;
+  bool llrand_high_bit = false;
+  for (long i = 0; i < draws; i++) {
+    long l = stream.lrand(10);
+    xbt_assert(l >= 0 && l < 10, "lrand(10) returned %ld", l);
+    lrand_histogram[l]++;
+    l = stream.lrand();
+    xbt_assert(l >= 0, "lrand() returned a negative number");
+    lrand_high_bit = lrand_high_bit || (l >> (sizeof(long) * 8 - 2)) != 0;
+    unsigned long long ll = stream.llrand(7);
+    xbt_assert(ll < 7, "llrand(7) returned %llu", ll);
+    llrand_histogram[ll]++;
+    llrand_high_bit = llrand_high_bit || (stream.llrand() >> 63) != 0;
+    double f = stream.frand();
+    xbt_assert(f >= 0 && f < 1, "frand() returned %f", f);
+    frand_histogram[(size_t)(f * 16)]++;
+    double scaled = stream.frand(600);
+    xbt_assert(scaled >= 0 && scaled < 600, "frand(600) returned %f", scaled);
+    xbt_assert(stream.lrand(1) == 0 && stream.llrand(1) == 0, "A limit of 1 should always give 0");
+  }
+  xbt_assert(lrand_high_bit && llrand_high_bit, "The highest bits are never set without a limit");
+  check_evenly_spread(lrand_histogram, draws);
+  check_evenly_spread(llrand_histogram, draws);
+  check_evenly_spread(frand_histogram, draws);
+}
+
+int main()
+{
+  check_keys();
+  check_interleaved_draws();
+  check_ranges();
+  return 0;
+}
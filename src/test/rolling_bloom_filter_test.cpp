@@ -0,0 +1,103 @@
+/*
+* Checks that RollingBloomFilter always remembers the last max_elements ids inserted, that it forgets the oldest
+* generation when a new one starts, that its false positive rate stays around the requested one however many ids go
+* through it, and that reset() forgets everything. The smallest filter, with room for a single id, is covered too.
+*/
+#include "test_helpers.hpp"
+#include "../rolling_bloom_filter.hpp"
+#include <deque>
+
+static void check_filter(unsigned int max_elements, double fp_rate, uint32_t tweak)
+{
+  RollingBloomFilter filter(max_elements, fp_rate, tweak);
+  size_t memory_size = filter.get_memory_size();
+  std::deque<object_id_t> last_inserted;
+  // Sequential ids with gaps, as the nodes see them, going through the filter several times over
+  object_id_t next_id = 1;
+  for (unsigned int i = 0; i < max_elements * 10; i++) {
+    filter.insert(next_id);
+    last_inserted.push_back(next_id);
+    if (last_inserted.size() > max_elements) {
+      last_inserted.pop_front();
+    }
+    next_id += 1 + i % 3;
+    if (i % 97 == 0 || max_elements < 10) {
+      for (auto const& id : last_inserted) {
+        xbt_assert(filter.contains(id), "Forgot %u, one of the last %u ids inserted, after %u inserts", id, max_elements, i + 1);
+      }
+    }
+  }
+  xbt_assert(filter.get_memory_size() == memory_size, "The filter grew from %zu to %zu bytes", memory_size, filter.get_memory_size());
+
+  // Ids never inserted: the ones in the gaps and the ones after the last one
+  unsigned int false_positives = 0;
+  unsigned int checked = 0;
+  for (object_id_t id = next_id; checked < 100000; id++, checked++) {
+    false_positives += filter.contains(id);
+  }
+  double measured_fp_rate = (double) false_positives / checked;
+  xbt_assert(measured_fp_rate <= fp_rate * 2, "False positive rate is %f with %u elements, expected about %f", measured_fp_rate, max_elements, fp_rate);
+
+  // An empty filter has no bit set, so nothing can be a false positive
+  filter.reset();
+  unsigned int remembered = 0;
+  for (auto const& id : last_inserted) {
+    remembered += filter.contains(id);
+  }
+  xbt_assert(remembered == 0, "%u ids are still there after reset()", remembered);
+}
+
+// With room for 100 ids, generations take 50. The 3 of them hold the last 150 ids, and the first one is wiped when
+// the 151st id comes in
+static void check_generations()
+{
+  RollingBloomFilter filter(100, 0.000001, 0);
+  for (object_id_t id = 1; id <= 150; id++) {
+    filter.insert(id);
+  }
+  for (object_id_t id = 1; id <= 150; id++) {
+    xbt_assert(filter.contains(id), "Forgot %u before its generation was reused", id);
+  }
+  filter.insert(151);
+  for (object_id_t id = 1; id <= 50; id++) {
+    xbt_assert(!filter.contains(id), "Still remembers %u after its generation was reused", id);
+  }
+  for (object_id_t id = 51; id <= 151; id++) {
+    xbt_assert(filter.contains(id), "Forgot %u, whose generation wasn't reused", id);
+  }
+  // Ids inserted after a reset() start a new first generation
+  filter.reset();
+  filter.insert(UINT32_MAX);
+  xbt_assert(filter.contains(UINT32_MAX) && !filter.contains(151), "Wrong contents after reset() and insert()");
+}
+
+// Different tweaks make the filters give different false positives for the same ids
+static void check_tweaks()
+{
+  RollingBloomFilter first(1000, 0.01, 1);
+  RollingBloomFilter second(1000, 0.01, 2);
+  std::vector<object_id_t> ids = random_sorted_ids(1000, 1000000);
+  for (auto const& id : ids) {
+    first.insert(id);
+    second.insert(id);
+  }
+  unsigned int both = 0;
+  unsigned int any = 0;
+  for (object_id_t id = 1000000; id < 1100000; id++) {
+    both += first.contains(id) && second.contains(id);
+    any += first.contains(id) || second.contains(id);
+  }
+  xbt_assert(any > 0 && both < any / 10, "Tweaks don't change the false positives: %u in both filters, %u in any", both, any);
+}
+
+int main()
+{
+  check_filter(1, 0.01, 0);
+  check_filter(2, 0.01, 0);
+  check_filter(100, 0.01, 1);
+  check_filter(5000, 0.001, 2);
+  check_filter(20000, 0.000001, 3);
+  check_generations();
+  check_tweaks();
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*
+* The kernels of sorted_ids.hpp, for every implementation the CPU supports. The vectorized ones work on blocks of
+* 4 or 8 ids and finish with a scalar tail, so every pair of sizes up to a few blocks is covered, plus the cases
+* that stress the block comparisons: all ids equal, ranges that don't overlap, runs of consecutive ids, and the
+* highest id. Output buffers have exactly the size sorted_ids.hpp asks for, so overflows show up with ASan.
+*/
+#include "test_helpers.hpp"
+#include "../sorted_ids.hpp"
+#include <algorithm>
+#include <iterator>
+
+static void check_kernels(const std::vector<object_id_t> & left, const std::vector<object_id_t> & right, const char* impl_name)
+{
+  std::vector<object_id_t> expected;
+  std::set_intersection(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(expected));
+  std::vector<object_id_t> out(std::min(left.size(), right.size()));
+  out.resize(intersect_sorted_ids(left.data(), left.size(), right.data(), right.size(), out.data()));
+  xbt_assert(out == expected, "Wrong %s intersection of %zu and %zu ids", impl_name, left.size(), right.size());
+
+  expected.clear();
+  std::set_difference(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(expected));
+  out.assign(left.size(), 0);
+  out.resize(diff_sorted_ids(left.data(), left.size(), right.data(), right.size(), out.data()));
+  xbt_assert(out == expected, "Wrong %s difference of %zu and %zu ids", impl_name, left.size(), right.size());
+
+  expected.clear();
+  std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(expected));
+  out.assign(left.size() + right.size(), 0);
+  out.resize(union_sorted_ids(left.data(), left.size(), right.data(), right.size(), out.data()));
+  xbt_assert(out == expected, "Wrong %s union of %zu and %zu ids", impl_name, left.size(), right.size());
+}
+
+// Consecutive ids from first
+static std::vector<object_id_t> run_of_ids(object_id_t first, size_t count)
+{
+  std::vector<object_id_t> ids(count);
+  for (size_t i = 0; i < count; i++) {
+    ids[i] = first + i;
+  }
+  return ids;
+}
+
+static void check_implementation(const char* impl_name)
+{
+  for (size_t left_size = 0; left_size <= 33; left_size++) {
+    for (size_t right_size = 0; right_size <= 33; right_size++) {
+      // Equal, disjoint (one side after the other) and shifted by a few ids, so blocks partially match
+      check_kernels(run_of_ids(0, left_size), run_of_ids(0, right_size), impl_name);
+      check_kernels(run_of_ids(0, left_size), run_of_ids(left_size, right_size), impl_name);
+      check_kernels(run_of_ids(3, left_size), run_of_ids(0, right_size), impl_name);
+      // Dense random ids, so most of them match, and sparse ones, so few do
+      check_kernels(random_sorted_ids(left_size, 64), random_sorted_ids(right_size, 64), impl_name);
+      check_kernels(random_sorted_ids(left_size, 1000), random_sorted_ids(right_size, 1000), impl_name);
+    }
+  }
+  // The highest ids, where a signed comparison would go wrong
+  std::vector<object_id_t> highest = run_of_ids(UINT32_MAX - 20, 21);
+  check_kernels(highest, run_of_ids(0, 20), impl_name);
+  check_kernels(highest, {UINT32_MAX - 19, UINT32_MAX}, impl_name);
+  for (int i = 0; i < 100; i++) {
+    check_kernels(random_sorted_ids(random_below(2000), UINT32_MAX), random_sorted_ids(random_below(2000), UINT32_MAX), impl_name);
+  }
+}
+
+int main()
+{
+  xbt_assert(use_sorted_ids_impl(SORTED_IDS_SCALAR), "The scalar implementation should always be supported");
+  for (e_sorted_ids_impl impl : {SORTED_IDS_SCALAR, SORTED_IDS_SSE42, SORTED_IDS_AVX2}) {
+    const char* impl_name = get_sorted_ids_impl_name(impl);
+    if (!use_sorted_ids_impl(impl)) {
+      printf("%s isn't supported by this CPU, skipping it\n", impl_name);
+      continue;
+    }
+    xbt_assert(get_sorted_ids_impl() == impl, "%s wasn't selected", impl_name);
+    check_implementation(impl_name);
+  }
+  return 0;
+}
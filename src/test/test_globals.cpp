@@ -0,0 +1,11 @@
+/*
+* Definitions that the code under test expects from bitcoin_simgrid.cpp, which the tests can't link as it has the
+* main() of the simulator.
+*/
+#include "../magic_constants.hpp"
+#include "simgrid/s4u.hpp"
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(bitcoin_simgrid, "bitcoin-simgrid tests logs");
+
+unsigned int SIMULATION_DURATION = 3600;
+unsigned int PRUNE_DEPTH = 0;
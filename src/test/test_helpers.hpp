@@ -0,0 +1,38 @@
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include "../aux_functions.hpp"
+#include <random>
+#include <set>
+#include <vector>
+
+/*
+* Shared by the unit tests in this directory. Each test is an executable that checks its structure with
+* xbt_assert, which aborts with a message on the first failure, and returns 0 if every check passed.
+*/
+
+// Every test draws from the same fixed seed, so a failure can be reproduced by running the test again
+inline std::mt19937 & test_random()
+{
+  static std::mt19937 generator(1);
+  return generator;
+}
+
+// Returns a number in [0, limit)
+inline unsigned int random_below(unsigned int limit)
+{
+  return test_random()() % limit;
+}
+
+// Returns exactly size distinct ids in [0, max_value), sorted
+inline std::vector<object_id_t> random_sorted_ids(size_t size, object_id_t max_value)
+{
+  xbt_assert(size <= max_value, "Can't draw %zu distinct ids below %u", size, max_value);
+  std::set<object_id_t> ids;
+  while (ids.size() < size) {
+    ids.insert(test_random()() % max_value);
+  }
+  return std::vector<object_id_t>(ids.begin(), ids.end());
+}
+
+#endif /* TEST_HELPERS_HPP */
@@ -0,0 +1,28 @@
+#include "transactions_table.hpp"
+
+// The single instance of the table, shared among all nodes and miners
+TransactionsTable txs_table;
+
+object_id_t TransactionsTable::create(long size, long fee_per_byte, double confirmed, double created)
+{
+  object_id_t id = next_object_id();
+  // Blocks get ids from the same sequence, so there may be a gap since the last tx
+  sizes.resize(id + 1);
+  fees_per_byte.resize(id + 1);
+  confirmed_times.resize(id + 1);
+  created_times.resize(id + 1);
+  sizes[id] = size;
+  fees_per_byte[id] = fee_per_byte;
+  confirmed_times[id] = confirmed;
+  created_times[id] = created;
+  return id;
+}
+
+long TransactionsTable::get_size(const std::vector<object_id_t> & ids) const
+{
+  long size = 0;
+  for (auto const& id : ids) {
+    size += sizes[id];
+  }
+  return size;
+}
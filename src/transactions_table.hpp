@@ -0,0 +1,58 @@
+#ifndef TRANSACTIONS_TABLE_HPP
+#define TRANSACTIONS_TABLE_HPP
+
+#include "aux_functions.hpp"
+#include <vector>
+
+/*
+* This is the single, append-only table with the data of every tx created during the simulation.
+* Data is stored as a structure of arrays indexed by the tx id, so blocks, messages and mempools only
+* need to keep tx ids. Given that txs and blocks share the same ids space, the positions corresponding
+* to block ids are left unused.
+*/
+class TransactionsTable
+{
+public:
+  // Registers a new tx and returns its id
+  object_id_t create(long size, long fee_per_byte, double confirmed, double created);
+
+  long get_size(object_id_t id) const
+  {
+    return sizes[id];
+  }
+
+  // Returns the sum of the sizes of the given txs
+  long get_size(const std::vector<object_id_t> & ids) const;
+
+  long get_fee_per_byte(object_id_t id) const
+  {
+    return fees_per_byte[id];
+  }
+
+  // When reproducing a trace, this is when the tx got confirmed in the real blockchain
+  double get_confirmed(object_id_t id) const
+  {
+    return confirmed_times[id];
+  }
+
+  double get_created(object_id_t id) const
+  {
+    return created_times[id];
+  }
+
+  // Returns the number of positions in the table, which is the id of the last tx plus one
+  size_t size() const
+  {
+    return sizes.size();
+  }
+private:
+  std::vector<int32_t> sizes;
+  std::vector<int32_t> fees_per_byte;
+  std::vector<double> confirmed_times;
+  std::vector<double> created_times;
+};
+
+// The single instance of the table, shared among all nodes and miners
+extern TransactionsTable txs_table;
+
+#endif /* TRANSACTIONS_TABLE_HPP */